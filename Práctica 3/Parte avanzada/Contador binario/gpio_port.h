@@ -0,0 +1,26 @@
+#ifndef GPIO_PORT_H
+#define GPIO_PORT_H
+#include <stdint.h>
+#include <esp_err.h>
+#include <driver/gpio.h>
+// Número máximo de pines (bits) de un puerto
+#define GPIO_PORT_MAX_PINS 8
+
+/* Puerto de salida de N bits sobre pines GPIO cualesquiera. Guarda, para cada bit, su máscara en los
+registros de salida (pines 0-31 y 32-39) para escribir todos los pines a la vez.*/
+struct gpio_port {
+    uint8_t num_pins;
+    // Máscara de cada bit y de todo el puerto en los registros de los pines 0-31 y 32-39
+    uint32_t bit_mask_low[GPIO_PORT_MAX_PINS];
+    uint32_t bit_mask_high[GPIO_PORT_MAX_PINS];
+    uint32_t port_mask_low;
+    uint32_t port_mask_high;
+};
+
+/* Configura como salida los "num_pins" pines de "pins" (el primero es el bit 0) y prepara el puerto.
+Deja todos los pines a 0.*/
+esp_err_t gpio_port_init(struct gpio_port * port, const gpio_num_t * pins, uint8_t num_pins);
+/* Escribe "value" en el puerto: los bits a 1 en una escritura a W1TS y los bits a 0 en otra a W1TC,
+sin pasar por el driver. Está en IRAM y se puede llamar desde una ISR o un callback de timer.*/
+void gpio_port_write(const struct gpio_port * port, uint32_t value);
+#endif
@@ -0,0 +1,111 @@
+#include <esp_log.h>
+#include <esp_attr.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <hal/gpio_ll.h>
+#include <soc/gpio_struct.h>
+#include "edge_capture.h"
+
+// Capacidad del buffer circular (potencia de 2): flancos que pueden acumularse sin perder ninguno
+#define EDGE_RING_SIZE CONFIG_EDGE_RING_SIZE
+// Los índices crecen sin límite y se reducen con %: solo es correcto al dar la vuelta si el tamaño divide a 2^32
+_Static_assert((EDGE_RING_SIZE & (EDGE_RING_SIZE - 1)) == 0, "CONFIG_EDGE_RING_SIZE must be a power of two");
+// Pila y prioridad de la tarea consumidora
+#define EDGE_CAPTURE_TASK_STACK_SIZE CONFIG_EDGE_CAPTURE_TASK_STACK_SIZE
+#define EDGE_CAPTURE_TASK_PRIORITY CONFIG_EDGE_CAPTURE_TASK_PRIORITY
+
+// TAG para logging
+static const char* TAG = "Edge capture";
+
+/* Buffer circular sin bloqueos con un único productor (la ISR) y un único consumidor (la tarea).
+Cada lado solo escribe su índice, así que no hacen falta secciones críticas.*/
+static struct edge_sample ring[EDGE_RING_SIZE];
+static volatile uint32_t ring_head = 0;
+static volatile uint32_t ring_tail = 0;
+// Flancos descartados con el buffer lleno
+static volatile uint32_t dropped = 0;
+// Tarea consumidora (la ISR la despierta con una notificación)
+static TaskHandle_t consumer_task_handle;
+
+// Rutina de tratamiento para las interrupciones en la entrada
+static void edge_isr_handler(void* arg);
+// Tarea que decodifica y muestra los flancos capturados
+static void edge_consumer_task(void* arg);
+
+
+static void IRAM_ATTR edge_isr_handler(void* arg){
+    // Solo anotamos nivel e instante: nada de formatear ni escribir por el puerto serie en la ISR
+    uint32_t head = ring_head;
+    if (head - ring_tail < EDGE_RING_SIZE) {
+        ring[head % EDGE_RING_SIZE].time_us = esp_timer_get_time();
+        ring[head % EDGE_RING_SIZE].level = gpio_ll_get_level(&GPIO, (gpio_num_t) (intptr_t) arg);
+        ring_head = head + 1;
+    }
+    else {
+        dropped++;
+    }
+    BaseType_t task_woken = pdFALSE;
+    vTaskNotifyGiveFromISR(consumer_task_handle, &task_woken);
+    if (task_woken) portYIELD_FROM_ISR();
+}
+
+static void edge_consumer_task(void* arg){
+    // Último flanco decodificado (el pin empieza a 0 por el pull-down)
+    struct edge_sample last = { .time_us = esp_timer_get_time(), .level = 0 };
+    uint32_t last_dropped = 0;
+    while(1){
+        // Esperamos a que la ISR avise de nuevos flancos
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        while (ring_tail != ring_head) {
+            struct edge_sample edge = ring[ring_tail % EDGE_RING_SIZE];
+            ring_tail++;
+            // Duración del nivel anterior (anchura del pulso que acaba con este flanco)
+            int64_t width_us = edge.time_us - last.time_us;
+            /* Si el nivel no ha cambiado respecto al flanco anterior, el pin volvió a su valor antes de que la
+            ISR lo leyese: hubo un pulso más corto que la latencia de la interrupción*/
+            if (edge.level == last.level) {
+                ESP_LOGW(TAG, "Glitch shorter than interrupt latency at %lld us (level %u)", edge.time_us, edge.level);
+            }
+            else {
+                ESP_LOGI(TAG, "The input value has changed. Current value is %u (previous level lasted %lld us)",
+                         edge.level, width_us);
+            }
+            last = edge;
+        }
+        if (dropped != last_dropped) {
+            last_dropped = dropped;
+            ESP_LOGW(TAG, "%u edges dropped (ring full)", last_dropped);
+        }
+    }
+    vTaskDelete(NULL);
+}
+
+void config_edge_capture(gpio_num_t pin){
+    // Variable para la configuración de pines GPIO
+    gpio_config_t io_conf = {};
+    /* Establecemos interrupciones por ambos flancos para ejecutar la isr
+        tanto con un cambio de 0 a 1 como de 1 a 0*/
+    io_conf.intr_type = GPIO_INTR_ANYEDGE;
+    // Ponemos los pines en modo entrada
+    io_conf.mode = GPIO_MODE_INPUT;
+    // Colocamos la máscara con el pin que se configura de esta forma
+    io_conf.pin_bit_mask = 1ULL << pin;
+    // Habilitamos las resistencias de pull-down (para que en reposo haya un 0 como entrada)
+    io_conf.pull_down_en = 1;
+    // Deshabilitamos las resistencias de pull-up
+    io_conf.pull_up_en = 0;
+    // Establecemos la configuración
+    ESP_ERROR_CHECK(gpio_config(&io_conf));
+    // Creamos la tarea consumidora antes de habilitar la interrupción que la notifica
+    xTaskCreate(edge_consumer_task, "Edge capture task", EDGE_CAPTURE_TASK_STACK_SIZE, NULL, EDGE_CAPTURE_TASK_PRIORITY,
+                &consumer_task_handle);
+    // Instalamos el servicio de interrupciones GPIO (la ISR está en IRAM y no se retrasa durante accesos a flash)
+    ESP_ERROR_CHECK(gpio_install_isr_service(ESP_INTR_FLAG_IRAM));
+    // Definimos la rutina de tratamiento de interrupciones para el pin de entrada (le pasamos el pin)
+    ESP_ERROR_CHECK(gpio_isr_handler_add(pin, edge_isr_handler, (void*) (intptr_t) pin));
+}
+
+uint32_t edge_capture_dropped(){
+    return dropped;
+}
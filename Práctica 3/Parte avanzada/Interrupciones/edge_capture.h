@@ -0,0 +1,15 @@
+#ifndef EDGE_CAPTURE_H
+#define EDGE_CAPTURE_H
+#include <stdint.h>
+#include <driver/gpio.h>
+// Flanco capturado: nivel del pin tras el cambio e instante (en us desde el arranque)
+struct edge_sample {
+    int64_t time_us;
+    uint8_t level;
+};
+/* Configura "pin" como entrada con interrupciones en ambos flancos y arranca la tarea que decodifica
+y muestra los flancos capturados. La ISR solo anota nivel e instante en un buffer circular.*/
+void config_edge_capture(gpio_num_t pin);
+// Número de flancos perdidos porque el buffer circular estaba lleno
+uint32_t edge_capture_dropped();
+#endif
@@ -0,0 +1,34 @@
+#include "adaptive_rate.h"
+
+void adaptive_rate_init(struct adaptive_rate * rate, uint32_t min_period, uint32_t max_period, uint16_t stable_samples, uint32_t now){
+    rate->min_period = min_period;
+    rate->max_period = max_period < min_period ? min_period : max_period;
+    rate->period = min_period;
+    rate->next = now + min_period;
+    rate->stable_samples = stable_samples;
+    rate->stable_count = 0;
+}
+
+bool adaptive_rate_due(struct adaptive_rate * rate, uint32_t now){
+    // Comparamos con la resta para que el desbordamiento del contador de tiempo no afecte
+    if ((int32_t) (now - rate->next) < 0) return false;
+    rate->next = now + rate->period;
+    return true;
+}
+
+uint32_t adaptive_rate_stable(struct adaptive_rate * rate){
+    if (rate->period < rate->max_period && ++rate->stable_count >= rate->stable_samples){
+        // Crecimiento multiplicativo: se llega al periodo máximo en pocas rachas estables
+        rate->period = rate->period > rate->max_period / 2 ? rate->max_period : rate->period * 2;
+        rate->stable_count = 0;
+    }
+    return rate->period;
+}
+
+uint32_t adaptive_rate_activity(struct adaptive_rate * rate, uint32_t now){
+    rate->period = rate->min_period;
+    rate->stable_count = 0;
+    // La siguiente muestra no puede quedar más lejos que un periodo mínimo
+    if ((int32_t) (rate->next - (now + rate->min_period)) > 0) rate->next = now + rate->min_period;
+    return rate->period;
+}
@@ -0,0 +1,30 @@
+#ifndef ADAPTIVE_RATE_H
+#define ADAPTIVE_RATE_H
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Controlador del periodo de muestreo de un sensor. Mientras las lecturas son estables el periodo se
+duplica cada "stable_samples" muestras hasta "max_period"; en cuanto un detector de cambios salta vuelve
+a "min_period". Las unidades (ms, s, ticks de la FSM...) las decide quien lo usa.*/
+struct adaptive_rate {
+    uint32_t min_period;
+    uint32_t max_period;
+    // Periodo actual e instante de la siguiente muestra
+    uint32_t period;
+    uint32_t next;
+    // Muestras estables seguidas que hacen falta para alargar el periodo y las que llevamos
+    uint16_t stable_samples;
+    uint16_t stable_count;
+};
+
+// Prepara el controlador con el periodo mínimo y la primera muestra en "now" + "min_period"
+void adaptive_rate_init(struct adaptive_rate * rate, uint32_t min_period, uint32_t max_period, uint16_t stable_samples, uint32_t now);
+// Devuelve true si en el instante "now" toca muestrear y en tal caso programa la siguiente muestra
+bool adaptive_rate_due(struct adaptive_rate * rate, uint32_t now);
+/* Anota una muestra en la que no ha saltado ningún detector. Devuelve el periodo para las siguientes
+(alargado si ya llevamos "stable_samples" estables seguidas)*/
+uint32_t adaptive_rate_stable(struct adaptive_rate * rate);
+/* Anota que un detector ha saltado en "now": vuelve al periodo mínimo y adelanta la siguiente muestra a
+"now" + "min_period" si estaba programada más tarde. Devuelve el periodo mínimo.*/
+uint32_t adaptive_rate_activity(struct adaptive_rate * rate, uint32_t now);
+#endif
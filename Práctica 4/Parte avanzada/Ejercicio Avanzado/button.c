@@ -1,49 +1,128 @@
+#include <stdint.h>
 #include <driver/gpio.h>
+#include <esp_attr.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 #include <esp_timer.h>
+#include <esp_log.h>
 #include "button.h"
 #include "binary_counter_3bits.h"
+#include "task_plan.h"
 
 // Macro con el pin de entrada del botón
 #define GPIO_BUTTON CONFIG_GPIO_BUTTON
 // Mascara de los pines de entrada para la configuración
 #define GPIO_BUTTON_PIN_SEL (1ULL<<GPIO_BUTTON)
-#define ESP_INTR_FLAG_DEFAULT 0
-// Umbral de tiempo entre entradas a la RTI (en ms) para evitar rebotes al pulsar los botones
-#define DEBOUCE_THRESHOLD 150
-
-/* Variable que utilizaremos para eliminar vía software los rebotes
-(debounce) al presionar el botón. En los botones de los laboratorios la señal es
-muy limpia y no haría falta, pero en general puede producirse rebotes entrando
-a la RTI varias veces con una sola pulsación. En nuestro caso no sería un drama porque
-simplemente resetearía el contador varias veces. Los rebotes al soltar el botón suelen
-ser menos problemáticos, pero son dificiles de manejar vía software con interrupciones (no tanto
-si hiciesemos polling). No obstante, pensamos que mejor no estar muestreando el pin
-constantemente sino utilizar interrupciones. En los botones del laboratorio no hay
-problema con los rebotes cuando soltamos (el cambio de 1 a 0 es muy limpio sin posibles
-falsos 1s).*/
-static int64_t lastTimeInISR = 0;
+// Tiempo (en us) que la entrada debe permanecer estable para dar por terminados los rebotes
+#define DEBOUNCE_US (CONFIG_BUTTON_DEBOUNCE_MS * 1000LL)
+// Tiempo (en us) que hay que mantener el botón para que cuente como pulsación larga
+#define LONG_PRESS_US (CONFIG_BUTTON_LONG_PRESS_MS * 1000LL)
+// Número de flancos que caben en la cola entre la ISR y la tarea (potencia de 2)
+#define EDGE_QUEUE_LEN 16
+// Pila de la tarea del botón
+#define BUTTON_TASK_STACK_SIZE CONFIG_BUTTON_TASK_STACK_SIZE
+
+/* Cola sin bloqueos (un productor, la ISR, y un consumidor, la tarea) con los instantes de los flancos.
+La ISR solo anota el instante y despierta a la tarea; los rebotes se filtran después en la tarea,
+que decide el estado del botón cuando la entrada lleva DEBOUNCE_US sin cambiar.*/
+static int64_t edge_times[EDGE_QUEUE_LEN];
+static volatile uint32_t edge_head = 0;
+static volatile uint32_t edge_tail = 0;
+// TAG para los mensajes de logging
+static const char* TAG = "Button";
+// Tarea del botón (la ISR la despierta con una notificación)
+static TaskHandle_t button_task_handle;
+#if CONFIG_STATIC_ALLOCATION
+// Memoria de la tarea del botón, reservada en tiempo de enlazado
+static StackType_t button_task_stack[BUTTON_TASK_STACK_SIZE];
+static StaticTask_t button_task_buffer;
+#endif
 
 // Rutina de tratamiento para las interrupciones en la entrada
 static void button_isr_handler(void* arg);
+// Tarea con la máquina de estados que elimina los rebotes y genera los eventos del botón
+static void button_task(void * params);
+// Ejecuta la acción asociada a un evento del botón
+static void handle_event(enum button_event event);
 
 
-static void button_isr_handler(void* arg){
-    /* Si, desde la última vez que se ejecutó el cuerpo de la RTI ha pasado al menos el umbral
-    (no se trata de un rebote de una pulsación anterior) */
-    if (esp_timer_get_time() - lastTimeInISR> DEBOUCE_THRESHOLD){
-        // Reseteamos el contador
-        reset_counter_3b();
-        // Marcamos la última vez que se ejecuta el cuerpo de la RTI con el tiempo en ms actual desde el arranque
-        lastTimeInISR = esp_timer_get_time();
+static void IRAM_ATTR button_isr_handler(void* arg){
+    // Anotamos el instante del flanco (si la cola está llena lo descartamos: la tarea relee el pin igualmente)
+    uint32_t head = edge_head;
+    if (head - edge_tail < EDGE_QUEUE_LEN) {
+        edge_times[head % EDGE_QUEUE_LEN] = esp_timer_get_time();
+        edge_head = head + 1;
     }
+    // Despertamos a la tarea del botón
+    BaseType_t task_woken = pdFALSE;
+    vTaskNotifyGiveFromISR(button_task_handle, &task_woken);
+    if (task_woken) portYIELD_FROM_ISR();
+}
+
+static void handle_event(enum button_event event){
+    /* Reseteamos el contador al pulsar. Se hace desde la tarea y no desde la ISR, así que reset_counter_3b
+    puede cambiar los LEDs y publicar su evento con normalidad.*/
+    if (event == BUTTON_PRESS) reset_counter_3b();
+    else ESP_LOGD(TAG, "Button %s", event == BUTTON_RELEASE ? "released" : "long press");
+}
+
+static void button_task(void * params){
+    // Estado estable del botón e instante en que se pulsó
+    bool pressed = false;
+    int64_t press_time = 0;
+    bool long_press_sent = false;
+    // Primer y último flanco de la ráfaga de rebotes pendiente de estabilizar (0 si no hay ninguna)
+    int64_t burst_start = 0;
+    int64_t last_edge = 0;
+    while(1){
+        /* Esperamos a un nuevo flanco o, si hay algo pendiente, hasta que la entrada lleve DEBOUNCE_US
+        estable o se cumpla el tiempo de la pulsación larga (la espera hace de temporizador)*/
+        int64_t deadline = INT64_MAX;
+        if (last_edge != 0) deadline = last_edge + DEBOUNCE_US;
+        else if (pressed && !long_press_sent) deadline = press_time + LONG_PRESS_US;
+        TickType_t wait = portMAX_DELAY;
+        if (deadline != INT64_MAX) {
+            int64_t remaining = deadline - esp_timer_get_time();
+            wait = remaining > 0 ? remaining / (portTICK_PERIOD_MS * 1000) + 1 : 0;
+        }
+        ulTaskNotifyTake(pdTRUE, wait);
+        // Recogemos los flancos que ha anotado la ISR
+        while (edge_tail != edge_head) {
+            last_edge = edge_times[edge_tail % EDGE_QUEUE_LEN];
+            if (burst_start == 0) burst_start = last_edge;
+            edge_tail++;
+        }
+        int64_t now = esp_timer_get_time();
+        if (last_edge != 0 && now - last_edge >= DEBOUNCE_US) {
+            // La entrada ya es estable: su nivel decide si ha habido pulsación o liberación (pull-down: 1 es pulsado)
+            bool level = gpio_get_level(GPIO_BUTTON);
+            if (level && !pressed) {
+                pressed = true;
+                long_press_sent = false;
+                press_time = burst_start;
+                handle_event(BUTTON_PRESS);
+            }
+            else if (!level && pressed) {
+                pressed = false;
+                handle_event(BUTTON_RELEASE);
+            }
+            burst_start = 0;
+            last_edge = 0;
+        }
+        if (pressed && !long_press_sent && last_edge == 0 && now - press_time >= LONG_PRESS_US) {
+            long_press_sent = true;
+            handle_event(BUTTON_LONG_PRESS);
+        }
+    }
+    vTaskDelete(NULL);
 }
 
 void config_button(){
     // Variable para la configuración de pines GPIO
     gpio_config_t io_conf = {};
-    // Establecemos interrupciones
-    io_conf.intr_type = GPIO_INTR_POSEDGE;
-    // Ponemos los pines en modo salida
+    // Interrupciones en ambos flancos para detectar tanto la pulsación como la liberación
+    io_conf.intr_type = GPIO_INTR_ANYEDGE;
+    // Ponemos los pines en modo entrada
     io_conf.mode = GPIO_MODE_INPUT;
     /* Colocamos la máscara con los pines que se configuran de esta forma.
     Habilitamos las resistencias de pull-down para que haya un 0 en reposo en
@@ -53,8 +132,17 @@ void config_button(){
     io_conf.pull_up_en = 0;
     // Establecemos la configuración
     ESP_ERROR_CHECK(gpio_config(&io_conf));
-    // Instalamos el servicio de interrupciones GPIO
-    ESP_ERROR_CHECK(gpio_install_isr_service(ESP_INTR_FLAG_DEFAULT));
+    /* Creamos la tarea que tratará los flancos del botón antes de habilitar la interrupción (la ISR la notifica),
+    con la prioridad y el núcleo de la tabla de tareas*/
+    struct task_plan_entry plan = task_plan_get(TASK_PLAN_BUTTON);
+#if CONFIG_STATIC_ALLOCATION
+    button_task_handle = xTaskCreateStaticPinnedToCore(button_task, "Task button", BUTTON_TASK_STACK_SIZE, NULL, plan.priority,
+                                                       button_task_stack, &button_task_buffer, plan.core);
+#else
+    xTaskCreatePinnedToCore(button_task, "Task button", BUTTON_TASK_STACK_SIZE, NULL, plan.priority, &button_task_handle, plan.core);
+#endif
+    // Instalamos el servicio de interrupciones GPIO (la ISR está en IRAM y sigue atendiéndose durante escrituras en flash)
+    ESP_ERROR_CHECK(gpio_install_isr_service(ESP_INTR_FLAG_IRAM));
     // Definimos la rutina de tratamiento de interrupciones para el pin de entrada
     ESP_ERROR_CHECK(gpio_isr_handler_add(GPIO_BUTTON, button_isr_handler, NULL));
-}
\ No newline at end of file
+}
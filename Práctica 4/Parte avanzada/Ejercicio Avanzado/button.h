@@ -1,5 +1,13 @@
 #ifndef BUTTON_H
 #define BUTTON_H
-// Método para la configuración del pin para el botón
+// Eventos del botón una vez eliminados los rebotes
+enum button_event {
+    BUTTON_PRESS,
+    BUTTON_RELEASE,
+    // Se emite una vez si el botón sigue pulsado tras CONFIG_BUTTON_LONG_PRESS_MS
+    BUTTON_LONG_PRESS
+};
+/* Método para la configuración del pin para el botón. Los rebotes se filtran en una tarea y al pulsar
+se resetea el contador.*/
 void config_button();
 #endif
\ No newline at end of file
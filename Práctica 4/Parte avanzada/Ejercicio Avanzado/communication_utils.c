@@ -1,19 +1,34 @@
 #include "communication_utils.h"
+#include "task_plan.h"
+
+// Longitud de la cola de muestras
+#define SAMPLING_QUEUE_LEN CONFIG_SAMPLING_QUEUE_LEN
+
+#if CONFIG_STATIC_ALLOCATION
+// Memoria de la cola de muestras, reservada en tiempo de enlazado
+static uint8_t queue_sampling_storage[SAMPLING_QUEUE_LEN * sizeof(struct dataSendType *)];
+static StaticQueue_t queue_sampling_buffer;
+#endif
 
 // Definimos la base de eventos "mostrar"
 ESP_EVENT_DEFINE_BASE(SHOW_EVENT);
 
 void config_communication(){
-    // Creamos la cola con 10 posiciones para punteros a la estructura de datos
-    queue_sampling = xQueueCreate(10, sizeof( struct dataSendType * ));
+    // Creamos la cola para punteros a la estructura de datos
+#if CONFIG_STATIC_ALLOCATION
+    queue_sampling = xQueueCreateStatic(SAMPLING_QUEUE_LEN, sizeof( struct dataSendType * ), queue_sampling_storage, &queue_sampling_buffer);
+#else
+    queue_sampling = xQueueCreate(SAMPLING_QUEUE_LEN, sizeof( struct dataSendType * ));
+#endif
 
-     // Preparamos los argumentos del bucle de enventos para la distancia
+     // Preparamos los argumentos del bucle de enventos para la distancia (prioridad y núcleo de la tabla de tareas)
+    struct task_plan_entry plan = task_plan_get(TASK_PLAN_EVENT_LOOP);
     esp_event_loop_args_t event_loop_args = {
         .queue_size = 5,
         .task_name = "loop_task", // task will be created
-        .task_priority = uxTaskPriorityGet(NULL),
+        .task_priority = plan.priority,
         .task_stack_size = 2048,
-        .task_core_id = tskNO_AFFINITY
+        .task_core_id = plan.core
     };
     // Configuramos el bucle de eventos con dichos argumentos
     ESP_ERROR_CHECK(esp_event_loop_create(&event_loop_args, &event_loop));
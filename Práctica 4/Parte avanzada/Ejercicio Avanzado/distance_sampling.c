@@ -1,15 +1,17 @@
+#include <math.h>
 #include <esp_log.h>
 #include <freertos/FreeRTOS.h>
 #include <driver/adc.h>
 #include <esp_adc_cal.h>
-#include <esp_timer.h>
 #include <freertos/queue.h>
 #include "communication_utils.h"
 #include "distance_sampling.h"
+#include "filter_stage.h"
+#include "scheduler.h"
 
 // Utilizaremos el canal 6 del ADC1 (GPIO 34) para las lecturas del sensor
 #define ADC1_CHAN CONFIG_ADC1_CHAN
-// Periodo de muestreo entre lecturas a partir de un parámetro de menuconfig (será el periodo del timer)
+// Periodo de muestreo entre lecturas a partir de un parámetro de menuconfig (será el periodo del trabajo)
 #define READING_DISTANCE_PERIOD_MS CONFIG_READING_DISTANCE_PERIOD_MS
 // Atenuación de 11 dB para que el voltaje mediable pueda alcanzar los voltajes emitidos por el sensor (en torno a 3 V máximo)
 #define ADC_ATTEN ADC_ATTEN_DB_11
@@ -18,15 +20,20 @@
 // Número de muestras para cada lectura (se hace la media de todas para obtener el valor leído)
 #define NUMBER_SAMPLES_DISTANCE CONFIG_NUMBER_SAMPLES_DISTANCE
 
-/* Timer periódico para realizar las lecturas (lo hacemos global y privado porque lo utilizan 
-varias funciones públicas del módulo)*/
-static esp_timer_handle_t periodic_timer;
+/* Trabajo periódico del planificador que realiza las lecturas (lo hacemos global y privado porque lo
+utilizan varias funciones públicas del módulo)*/
+static int sampling_job;
+/* Etapa de filtrado de las muestras y bloques de muestras sin filtrar y filtradas (estáticos para no
+ocupar la pila de la tarea del planificador)*/
+static struct filter_stage distance_filter;
+static float raw_block[NUMBER_SAMPLES_DISTANCE];
+static float filtered_block[NUMBER_SAMPLES_DISTANCE];
 
-// Función callback para el timer de muestreo periódico del sensor
-static void sampling_timer_callback(void * args);
+// Trabajo periódico de muestreo del sensor
+static void sampling_job_callback(void * args);
 
 
-static void sampling_timer_callback(void * args){
+static void sampling_job_callback(void * args){
     // Hacemos un casting del puntero a la estrctura de características del ADC
     esp_adc_cal_characteristics_t * adc_chars_punt = (esp_adc_cal_characteristics_t *) args;
     // Variable de pila para la distancia
@@ -38,8 +45,6 @@ static void sampling_timer_callback(void * args){
     data_send->value_type = DISTANCE;
     // Reservamos espacio del heap para el valor (la distancia)
     data_send->value = (float *) malloc(sizeof(float));
-    // Inicializamos a 0 el acumulador para la media de las muestras
-    uint32_t adc_reading = 0;
     // Tantas veces como muestras haya por lectura
     for (int i = 0; i < NUMBER_SAMPLES_DISTANCE; i++){
         // Leemos un nuevo valor cuantizado del ADC
@@ -54,15 +59,19 @@ static void sampling_timer_callback(void * args){
             // Copiamos su valor en el espacio reservado anteriormente del heap
             *((float *)data_send->value) = distance;
             /* Ponemos valor de distancia -1 al final de la cola para que se muestre por el puerto serie
-            (ponemos los ticks de bloqueo a 0 porque estamos en callback de un timer)*/
+            (ponemos los ticks de bloqueo a 0 para no retrasar al resto de trabajos del planificador)*/
             xQueueSendToBack(queue_sampling, &data_send, 0);
             return;
         }
-        // Si la muestra es correcta la acumulamos
-        adc_reading += read;
+        // Si la muestra es correcta la guardamos en el bloque
+        raw_block[i] = read;
     }
-    // Dividimos las muestras acumuladas entre el número de muestras para obtener la media
-    adc_reading /= NUMBER_SAMPLES_DISTANCE;
+    // Pasamos el bloque por la etapa de filtrado (cada ráfaga se filtra por separado)
+    filter_stage_process(&distance_filter, raw_block, filtered_block, NUMBER_SAMPLES_DISTANCE);
+    // La lectura es la media de las muestras filtradas
+    float sum = 0;
+    for (int i = 0; i < NUMBER_SAMPLES_DISTANCE; i++) sum += filtered_block[i];
+    uint32_t adc_reading = sum > 0 ? lroundf(sum / NUMBER_SAMPLES_DISTANCE) : 0;
     // Obtenemos el voltaje a partir de la media de muestras y la caracterización del ADC
     uint32_t voltage = esp_adc_cal_raw_to_voltage(adc_reading, adc_chars_punt);
     /* Calculamos la distancia asociada a ese voltaje en el sensor, mediante la fórmula: 13/V.
@@ -71,7 +80,7 @@ static void sampling_timer_callback(void * args){
     // Copiamos el valor de la distancia en el espacio reservado anteriormente del heap
     *((float *)data_send->value) = distance;
     /* Ponemos valor de distancia al final de la cola para que se muestre por el puerto serie
-    (ponemos los ticks de bloqueo a 0 porque estamos en callback de un timer)*/
+    (ponemos los ticks de bloqueo a 0 para no retrasar al resto de trabajos del planificador)*/
     xQueueSendToBack(queue_sampling, &data_send, 0);
 }
 
@@ -90,25 +99,20 @@ void config_sampling_distance(){
     /* Extraemos las características (coeficientes de la recta nivel cuantizado vs voltaje) en "adc_chars_punt".
     Esta función no puede devolver error.*/
     esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN, ADC_WIDTH_BIT, 0, adc_chars_punt);
-
-    // Preparemos los argumentos del timer periódico para el muestreo.
-    const esp_timer_create_args_t periodic_timer_args = {
-        .callback = &sampling_timer_callback,
-        .name = "Sampling timer",
-        // Pasamos como atributo al timer un puntero a la estructura con las características del ADC.
-        .arg = adc_chars_punt
-    };
-    // Configuramos el timer con los mencionados argumentos. (Sin iniciarlo, hay otro método para ello)
-    ESP_ERROR_CHECK(esp_timer_create(&periodic_timer_args, &periodic_timer));
-
+    // Preparamos la etapa de filtrado de las muestras
+    ESP_ERROR_CHECK(filter_stage_init(&distance_filter, "distance"));
+    /* Registramos en el planificador el trabajo de muestreo (sin iniciarlo, hay otro método para ello),
+    con un puntero a la estructura con las características del ADC como argumento. Sin desfase: así sus
+    lecturas caen en los mismos ticks que las del resto de trabajos y se atienden en un solo despertar.*/
+    sampling_job = scheduler_add_job("distance", sampling_job_callback, adc_chars_punt, READING_DISTANCE_PERIOD_MS, 0);
 }
 
 void start_sampling_distance(){
-    // Inicializamos el timer cuyo callback realiza las lecturas del sensor.
-    ESP_ERROR_CHECK(esp_timer_start_periodic(periodic_timer, READING_DISTANCE_PERIOD_MS * 1000));
+    // Arrancamos el trabajo que realiza las lecturas del sensor
+    scheduler_start_job(sampling_job);
 }
 
 void stop_sampling_distance(){
-    // Paramos el timer cuyo callback realiza las lecturas del sensor
-    ESP_ERROR_CHECK(esp_timer_stop(periodic_timer));
+    // Paramos el trabajo que realiza las lecturas del sensor
+    scheduler_stop_job(sampling_job);
 }
\ No newline at end of file
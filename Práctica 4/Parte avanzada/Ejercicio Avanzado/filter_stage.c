@@ -0,0 +1,96 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <esp_log.h>
+#include <esp_cpu.h>
+#include "filter_stage.h"
+
+// Frecuencia de corte en milésimas de la frecuencia de muestreo
+#define SAMPLING_FILTER_CUTOFF (CONFIG_SAMPLING_FILTER_CUTOFF_PERMILLE / 1000.0f)
+// Número de coeficientes del FIR
+#define SAMPLING_FILTER_FIR_TAPS CONFIG_SAMPLING_FILTER_FIR_TAPS
+// Bloques entre informes de ciclos por muestra (0 para no informar)
+#define SAMPLING_FILTER_REPORT_BLOCKS CONFIG_SAMPLING_FILTER_REPORT_BLOCKS
+// Factor de calidad del biquad (Butterworth)
+#define BIQUAD_Q 0.7071f
+
+static const char* TAG = "Filter stage";
+
+#if CONFIG_SAMPLING_FILTER_FIR
+// Calcula un FIR paso bajo de fase lineal por el método de la sinc enventanada (ventana de Hann)
+static void design_fir_lowpass(float * coeffs, int taps, float cutoff);
+#endif
+#if !CONFIG_SAMPLING_FILTER_NONE
+/* Reinicia el estado del filtro como si la entrada hubiese valido siempre "initial" (así la primera
+muestra del bloque no arrastra un transitorio desde 0 ni la cola del bloque anterior)*/
+static void reset_state(struct filter_stage * stage, float initial);
+#endif
+
+
+#if CONFIG_SAMPLING_FILTER_FIR
+static void design_fir_lowpass(float * coeffs, int taps, float cutoff){
+    float sum = 0;
+    for (int i = 0; i < taps; i++){
+        float n = i - (taps - 1) / 2.0f;
+        float sinc = n == 0 ? 2 * cutoff : sinf(2 * M_PI * cutoff * n) / (M_PI * n);
+        float window = 0.5f - 0.5f * cosf(2 * M_PI * (i + 1) / (taps + 1));
+        coeffs[i] = sinc * window;
+        sum += coeffs[i];
+    }
+    // Ganancia unidad en continua: el valor medio de la señal no cambia
+    for (int i = 0; i < taps; i++) coeffs[i] /= sum;
+}
+#endif
+
+#if !CONFIG_SAMPLING_FILTER_NONE
+static void reset_state(struct filter_stage * stage, float initial){
+#if CONFIG_SAMPLING_FILTER_FIR
+    for (int i = 0; i < SAMPLING_FILTER_FIR_TAPS; i++) stage->fir_delay[i] = initial;
+#else
+    // Forma directa II: en régimen permanente w = x / (1 + a1 + a2)
+    float w = initial / (1 + stage->biquad_coeffs[3] + stage->biquad_coeffs[4]);
+    stage->biquad_state[0] = w;
+    stage->biquad_state[1] = w;
+#endif
+}
+#endif
+
+esp_err_t filter_stage_init(struct filter_stage * stage, const char * name){
+    memset(stage, 0, sizeof(struct filter_stage));
+    stage->name = name;
+#if CONFIG_SAMPLING_FILTER_FIR
+    stage->fir_coeffs = calloc(SAMPLING_FILTER_FIR_TAPS, sizeof(float));
+    stage->fir_delay = calloc(SAMPLING_FILTER_FIR_TAPS, sizeof(float));
+    if (stage->fir_coeffs == NULL || stage->fir_delay == NULL) return ESP_ERR_NO_MEM;
+    design_fir_lowpass(stage->fir_coeffs, SAMPLING_FILTER_FIR_TAPS, SAMPLING_FILTER_CUTOFF);
+    return dsps_fir_init_f32(&stage->fir, stage->fir_coeffs, stage->fir_delay, SAMPLING_FILTER_FIR_TAPS);
+#elif CONFIG_SAMPLING_FILTER_IIR
+    return dsps_biquad_gen_lpf_f32(stage->biquad_coeffs, SAMPLING_FILTER_CUTOFF, BIQUAD_Q);
+#else
+    return ESP_OK;
+#endif
+}
+
+void filter_stage_process(struct filter_stage * stage, const float * input, float * output, size_t len){
+    uint32_t start = esp_cpu_get_ccount();
+#if !CONFIG_SAMPLING_FILTER_NONE
+    if (len > 0) reset_state(stage, input[0]);
+#endif
+    /* dsps_fir_f32 y dsps_biquad_f32 usan las versiones optimizadas en ensamblador para el ESP32 o las
+    versiones ANSI C (_ansi) según la configuración de esp-dsp*/
+#if CONFIG_SAMPLING_FILTER_FIR
+    dsps_fir_f32(&stage->fir, (float *) input, output, len);
+#elif CONFIG_SAMPLING_FILTER_IIR
+    dsps_biquad_f32((float *) input, output, len, stage->biquad_coeffs, stage->biquad_state);
+#else
+    memcpy(output, input, len * sizeof(float));
+#endif
+    stage->cycles += esp_cpu_get_ccount() - start;
+    stage->samples += len;
+    stage->blocks++;
+    if (SAMPLING_FILTER_REPORT_BLOCKS > 0 && stage->blocks % SAMPLING_FILTER_REPORT_BLOCKS == 0 && stage->samples > 0){
+        ESP_LOGI(TAG, "%s: %u cycles/sample over %u samples", stage->name, (uint32_t) (stage->cycles / stage->samples), stage->samples);
+        stage->cycles = 0;
+        stage->samples = 0;
+    }
+}
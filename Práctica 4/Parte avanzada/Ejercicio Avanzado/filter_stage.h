@@ -0,0 +1,42 @@
+#ifndef FILTER_STAGE_H
+#define FILTER_STAGE_H
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include <sdkconfig.h>
+// esp-dsp solo hace falta si hay filtro
+#if !CONFIG_SAMPLING_FILTER_NONE
+#include "esp_dsp.h"
+#endif
+
+/* Etapa de filtrado entre la adquisición de un sensor y sus consumidores. Procesa bloques de muestras
+con esp-dsp (FIR paso bajo o biquad IIR paso bajo, según menuconfig). Cada bloque es una ráfaga de
+muestras separada de la anterior por todo un periodo de muestreo (que además puede cambiar), así que se
+filtra por separado: el estado del filtro se reinicia al principio de cada bloque en régimen permanente
+para su primera muestra. Cada sensor necesita su propia etapa, que lleva la cuenta de los ciclos de CPU
+por muestra.*/
+struct filter_stage {
+    // Nombre con el que se informa de los ciclos por muestra
+    const char * name;
+#if CONFIG_SAMPLING_FILTER_FIR
+    fir_f32_t fir;
+    float * fir_coeffs;
+    float * fir_delay;
+#elif CONFIG_SAMPLING_FILTER_IIR
+    // Coeficientes b0, b1, b2, a1, a2 y estado del biquad
+    float biquad_coeffs[5];
+    float biquad_state[2];
+#endif
+    // Ciclos de CPU y muestras procesadas desde el último informe, y bloques procesados
+    uint64_t cycles;
+    uint32_t samples;
+    uint32_t blocks;
+};
+
+// Prepara la etapa con los coeficientes del filtro elegido en menuconfig
+esp_err_t filter_stage_init(struct filter_stage * stage, const char * name);
+/* Filtra un bloque de "len" muestras de "input" en "output" (no pueden solaparse), sin arrastrar nada
+del bloque anterior. Cada
+CONFIG_SAMPLING_FILTER_REPORT_BLOCKS bloques informa de los ciclos por muestra.*/
+void filter_stage_process(struct filter_stage * stage, const float * input, float * output, size_t len);
+#endif
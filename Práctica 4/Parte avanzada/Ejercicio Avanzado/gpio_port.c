@@ -0,0 +1,55 @@
+#include <string.h>
+#include <esp_attr.h>
+#include <soc/gpio_reg.h>
+#include "gpio_port.h"
+
+
+esp_err_t gpio_port_init(struct gpio_port * port, const gpio_num_t * pins, uint8_t num_pins){
+    if (num_pins == 0 || num_pins > GPIO_PORT_MAX_PINS) return ESP_ERR_INVALID_ARG;
+    memset(port, 0, sizeof(struct gpio_port));
+    port->num_pins = num_pins;
+    uint64_t pin_sel = 0;
+    for (int i = 0; i < num_pins; i++){
+        if (!GPIO_IS_VALID_OUTPUT_GPIO(pins[i])) return ESP_ERR_INVALID_ARG;
+        pin_sel |= 1ULL << pins[i];
+        // Los pines 0-31 están en GPIO_OUT_REG y los 32-39 en GPIO_OUT1_REG
+        if (pins[i] < 32) port->bit_mask_low[i] = 1UL << pins[i];
+        else port->bit_mask_high[i] = 1UL << (pins[i] - 32);
+        port->port_mask_low |= port->bit_mask_low[i];
+        port->port_mask_high |= port->bit_mask_high[i];
+    }
+    // Variable para la configuración de pines GPIO
+    gpio_config_t io_conf = {};
+    // Deshabilitamos las interrupciones (de hecho al ser de salida no tiene sentido habilitar interrupciones)
+    io_conf.intr_type = GPIO_INTR_DISABLE;
+    // Establecemos los pines para salida
+    io_conf.mode = GPIO_MODE_OUTPUT;
+    // Colocamos la máscara con los pines afectados por esta configuración
+    io_conf.pin_bit_mask = pin_sel;
+    // Deshabilitamos el pull-down y el pull-up
+    io_conf.pull_down_en = 0;
+    io_conf.pull_up_en = 0;
+    // Establecemos la configuración
+    esp_err_t err = gpio_config(&io_conf);
+    if (err == ESP_OK) gpio_port_write(port, 0);
+    return err;
+}
+
+void IRAM_ATTR gpio_port_write(const struct gpio_port * port, uint32_t value){
+    // Traducimos el valor lógico a las posiciones de los pines en los registros de salida
+    uint32_t set_low = 0, set_high = 0;
+    for (int i = 0; i < port->num_pins; i++){
+        if (value & (1UL << i)){
+            set_low |= port->bit_mask_low[i];
+            set_high |= port->bit_mask_high[i];
+        }
+    }
+    /* Los registros W1TS/W1TC solo afectan a los bits escritos a 1, así que no hace falta leer-modificar-escribir
+    ni proteger la escritura frente a otros usos de los demás pines*/
+    REG_WRITE(GPIO_OUT_W1TS_REG, set_low);
+    REG_WRITE(GPIO_OUT_W1TC_REG, port->port_mask_low & ~set_low);
+    if (port->port_mask_high != 0){
+        REG_WRITE(GPIO_OUT1_W1TS_REG, set_high);
+        REG_WRITE(GPIO_OUT1_W1TC_REG, port->port_mask_high & ~set_high);
+    }
+}
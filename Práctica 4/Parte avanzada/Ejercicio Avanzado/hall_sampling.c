@@ -1,30 +1,69 @@
+#include <stdlib.h>
+#include <math.h>
 #include <esp_log.h>
 #include <freertos/FreeRTOS.h>
 #include <driver/adc.h>
-#include <esp_timer.h>
 #include <freertos/queue.h>
 #include "hall_sampling.h"
 #include "communication_utils.h"
+#include "adaptive_rate.h"
+#include "filter_stage.h"
+#include "scheduler.h"
 
-// Periodo de muestreo entre lecturas obtenido a partir de un parámetro de menuconfig
+/* Periodo de muestreo entre lecturas obtenido a partir de un parámetro de menuconfig (el que se usa
+mientras la lectura varía) y periodo máximo al que se alarga cuando las lecturas son estables*/
 #define READING_HALL_PERIOD_MS CONFIG_READING_HALL_PERIOD_MS
+#define READING_HALL_MAX_PERIOD_MS CONFIG_READING_HALL_MAX_PERIOD_MS
+// Muestras estables seguidas tras las que se duplica el periodo
+#define HALL_STABLE_SAMPLES CONFIG_HALL_STABLE_SAMPLES
+// Variación respecto a la lectura anterior (en tanto por ciento) que se considera actividad
+#define HALL_VARIATION_PCT 20
 // Precisión de 12 bits para cuantizar con hasta 2^12 niveles lógicos.
 #define ADC_WIDTH_BIT ADC_WIDTH_BIT_12
+// Número de muestras seguidas del sensor que forman una lectura (un bloque de la etapa de filtrado)
+#define HALL_SAMPLES_PER_READING CONFIG_HALL_SAMPLES_PER_READING
 
-// Timer periódico para realizar las lecturas
-static esp_timer_handle_t periodic_timer;
+/* Trabajo periódico del planificador que realiza las lecturas. El propio trabajo cambia su periodo
+al que decida el controlador de muestreo adaptativo*/
+static int sampling_job;
+// Controlador del periodo de muestreo (en ms)
+static struct adaptive_rate hall_rate;
+// Última lectura, para detectar variaciones, y periodo del trabajo
+static int last_hall_val;
+static uint32_t last_period;
+// Etapa de filtrado de las muestras del sensor y bloques de muestras sin filtrar y filtradas
+static struct filter_stage hall_filter;
+static float raw_block[HALL_SAMPLES_PER_READING];
+static float filtered_block[HALL_SAMPLES_PER_READING];
 
-// Función callback para el timer de muestreo periódico del sensor
-static void sampling_timer_callback(void * args);
+// Trabajo periódico de muestreo del sensor
+static void sampling_job_callback(void * args);
 
 
-static void sampling_timer_callback(void * args){
+static void sampling_job_callback(void * args){
     /* Leemos un nuevo dato del sensor y lo guardamos en la variable global.
     (Nos parecería mejor no utilizar dicha variable gloabl y enviar el dato directamente
     argumento del evento. Sin embargo, estamos siguiente el mismo patrón que nos
     pidió el enunciado para el sensor de distancias del ejericio anterior
     que hemos mantenido también en este)*/
-    int hall_val = hall_sensor_read();
+    for (int i = 0; i < HALL_SAMPLES_PER_READING; i++) raw_block[i] = hall_sensor_read();
+    /* Pasamos el bloque por la etapa de filtrado (cada ráfaga se filtra por separado) y la lectura
+    es la media del bloque filtrado*/
+    filter_stage_process(&hall_filter, raw_block, filtered_block, HALL_SAMPLES_PER_READING);
+    float sum = 0;
+    for (int i = 0; i < HALL_SAMPLES_PER_READING; i++) sum += filtered_block[i];
+    int hall_val = lroundf(sum / HALL_SAMPLES_PER_READING);
+    /* Si la lectura varía más de un HALL_VARIATION_PCT % respecto a la anterior volvemos al periodo
+    mínimo; si no, el periodo se alarga tras varias lecturas estables seguidas*/
+    uint32_t period;
+    if (abs(hall_val - last_hall_val) * 100 > HALL_VARIATION_PCT * abs(last_hall_val))
+        period = adaptive_rate_activity(&hall_rate, 0);
+    else
+        period = adaptive_rate_stable(&hall_rate);
+    // Solo avisamos al planificador si el periodo cambia (un periodo estable no toca la tabla de trabajos)
+    if (period != last_period) scheduler_set_period(sampling_job, period);
+    last_period = period;
+    last_hall_val = hall_val;
     // Reservamos espacio en el heap para la estructura con los datos
     struct dataSendType * data_send = (struct dataSendType *) malloc(sizeof(struct dataSendType));
     // Colocamos el tipo correspondiente del enumerado
@@ -33,29 +72,31 @@ static void sampling_timer_callback(void * args){
     data_send->value = (int *) malloc(sizeof(int));
     *(int *) data_send->value = hall_val;
     /* Ponemos valor del sensor al final de la cola para que se muestre por el puerto serie
-    (ponemos los ticks de bloqueo a 0 porque estamos en callback de un timer)*/
+    (ponemos los ticks de bloqueo a 0 para no retrasar al resto de trabajos del planificador)*/
     xQueueSendToBack(queue_sampling, &data_send, 0);
 }
 
 void config_sampling_hall(){
     // Configuramos la precisión del ADC para la lectura del sensor
     ESP_ERROR_CHECK(adc1_config_width(ADC_WIDTH_BIT));
-    //Argumentos del timer periódico para el muestreo del sensor
-    const esp_timer_create_args_t periodic_timer_args = {
-        .callback = &sampling_timer_callback,
-            /* name is optional, but may help identify the timer when debugging */
-        .name = "Sampling timer"
-    };
-    // Configuramos el timer con los mencionados argumentos. (Sin iniciarlo, hay otro método para ello)
-    ESP_ERROR_CHECK(esp_timer_create(&periodic_timer_args, &periodic_timer));
+    // Preparamos la etapa de filtrado de las muestras
+    ESP_ERROR_CHECK(filter_stage_init(&hall_filter, "hall"));
+    // Registramos en el planificador el trabajo de muestreo (sin iniciarlo, hay otro método para ello)
+    sampling_job = scheduler_add_job("hall", sampling_job_callback, NULL, READING_HALL_PERIOD_MS, 0);
 }
 
 void start_sampling_hall(){
-    // Inicializamos el timer cuyo callback realiza las lecturas del sensor
-    ESP_ERROR_CHECK(esp_timer_start_periodic(periodic_timer, READING_HALL_PERIOD_MS * 1000));
+    /* Empezamos con el periodo mínimo. El controlador solo se usa para el periodo (el planificador marca
+    los instantes), así que el tiempo que se le pasa no importa*/
+    adaptive_rate_init(&hall_rate, READING_HALL_PERIOD_MS, READING_HALL_MAX_PERIOD_MS, HALL_STABLE_SAMPLES, 0);
+    last_hall_val = hall_sensor_read();
+    last_period = READING_HALL_PERIOD_MS;
+    scheduler_set_period(sampling_job, READING_HALL_PERIOD_MS);
+    // Arrancamos el trabajo que realiza las lecturas del sensor
+    scheduler_start_job(sampling_job);
 }
 
 void stop_sampling_hall(){
-    // Paramos el timer cuyo callback realiza las lecturas del sensor
-    ESP_ERROR_CHECK(esp_timer_stop(periodic_timer));
+    // Paramos el trabajo que realiza las lecturas del sensor
+    scheduler_stop_job(sampling_job);
 }
\ No newline at end of file
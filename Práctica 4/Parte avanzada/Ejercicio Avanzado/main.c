@@ -6,8 +6,12 @@
 #include "binary_counter_3bits.h"
 #include "communication_utils.h"
 #include "button.h"
+#include "scheduler.h"
 
 void app_main(void){
+    /* Preparamos el planificador que ejecuta los trabajos periódicos de los módulos (un único timer y una
+    única tarea en lugar de un timer por módulo)*/
+    config_scheduler();
     // Configuramos la comunicación entre los módulos productores y el módulo que muestra los datos
     config_communication();
     // Configuramos el módulo que muestra la información (inicialización del bucle de eventos)
@@ -0,0 +1,217 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include "scheduler.h"
+#include "task_plan.h"
+
+// Tick del planificador en ms (resolución de periodos y desfases)
+#define SCHEDULER_TICK_MS CONFIG_SCHEDULER_TICK_MS
+// Pila de la tarea que ejecuta los trabajos
+#define SCHEDULER_TASK_STACK_SIZE CONFIG_SCHEDULER_TASK_STACK_SIZE
+// Periodo con el que se muestran las estadísticas (0 para no mostrarlas)
+#define SCHEDULER_STATS_PERIOD_MS CONFIG_SCHEDULER_STATS_PERIOD_MS
+// Número máximo de trabajos
+#define SCHEDULER_MAX_JOBS 8
+
+static const char* TAG = "Scheduler";
+
+// Trabajo periódico registrado
+struct scheduler_job {
+    const char * name;
+    scheduler_job_fn func;
+    void * arg;
+    // Periodo y desfase en ticks, y tick de la siguiente ejecución
+    uint32_t period;
+    uint32_t phase;
+    uint32_t next;
+    bool running;
+    struct scheduler_job_stats stats;
+};
+
+static struct scheduler_job jobs[SCHEDULER_MAX_JOBS];
+static int num_jobs = 0;
+// Protege la tabla de trabajos (la modifican otras tareas y la recorre la tarea del planificador)
+static portMUX_TYPE jobs_lock = portMUX_INITIALIZER_UNLOCKED;
+// Instante del tick 0
+static int64_t start_us;
+// Único timer del planificador y tarea que ejecuta los trabajos
+static esp_timer_handle_t tick_timer;
+static TaskHandle_t scheduler_task_handle;
+#if CONFIG_STATIC_ALLOCATION
+// Memoria de la tarea del planificador, reservada en tiempo de enlazado
+static StackType_t scheduler_task_stack[SCHEDULER_TASK_STACK_SIZE];
+static StaticTask_t scheduler_task_buffer;
+#endif
+
+// Pasa milisegundos a ticks (como mínimo 1)
+static uint32_t ms_to_ticks(uint32_t ms);
+// Tick actual
+static uint32_t current_tick();
+// Siguiente tick posterior a "tick" que corresponde al periodo y desfase de un trabajo
+static uint32_t next_aligned_tick(const struct scheduler_job * job, uint32_t tick);
+// Callback del timer: despierta a la tarea del planificador
+static void tick_timer_callback(void * args);
+// Arma el timer para el primer tick con algún trabajo pendiente
+static void arm_timer();
+// Tarea que ejecuta los trabajos pendientes en cada tick
+static void scheduler_task(void * args);
+// Trabajo que muestra periódicamente las estadísticas
+static void stats_job(void * args);
+
+
+static uint32_t ms_to_ticks(uint32_t ms){
+    uint32_t ticks = (ms + SCHEDULER_TICK_MS / 2) / SCHEDULER_TICK_MS;
+    return ticks > 0 ? ticks : 1;
+}
+
+static uint32_t current_tick(){
+    return (esp_timer_get_time() - start_us) / (SCHEDULER_TICK_MS * 1000);
+}
+
+static uint32_t next_aligned_tick(const struct scheduler_job * job, uint32_t tick){
+    if (tick < job->phase) return job->phase;
+    return job->phase + ((tick - job->phase) / job->period + 1) * job->period;
+}
+
+static void tick_timer_callback(void * args){
+    xTaskNotifyGive(scheduler_task_handle);
+}
+
+static void arm_timer(){
+    bool pending = false;
+    uint32_t now = current_tick();
+    uint32_t first = 0;
+    portENTER_CRITICAL(&jobs_lock);
+    for (int i = 0; i < num_jobs; i++){
+        if (!jobs[i].running) continue;
+        if (!pending || (int32_t) (jobs[i].next - first) < 0) first = jobs[i].next;
+        pending = true;
+    }
+    portEXIT_CRITICAL(&jobs_lock);
+    // El timer solo despierta a la CPU en los ticks en los que hay algo que hacer
+    esp_timer_stop(tick_timer);
+    if (!pending) return;
+    int64_t delay = start_us + (int64_t) first * SCHEDULER_TICK_MS * 1000 - esp_timer_get_time();
+    if ((int32_t) (first - now) <= 0 || delay < 0) delay = 0;
+    ESP_ERROR_CHECK(esp_timer_start_once(tick_timer, delay));
+}
+
+static void scheduler_task(void * args){
+    while(1){
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        uint32_t tick = current_tick();
+        for (int i = 0; i < num_jobs; i++){
+            struct scheduler_job * job = &jobs[i];
+            portENTER_CRITICAL(&jobs_lock);
+            bool due = job->running && (int32_t) (tick - job->next) >= 0;
+            int64_t due_us = start_us + (int64_t) job->next * SCHEDULER_TICK_MS * 1000;
+            if (due){
+                // Los periodos enteros que ya han pasado sin ejecutarse cuentan como desbordamientos
+                uint32_t missed = (tick - job->next) / job->period;
+                job->stats.overruns += missed;
+                job->next += (missed + 1) * job->period;
+            }
+            portEXIT_CRITICAL(&jobs_lock);
+            if (!due) continue;
+            int64_t jitter = esp_timer_get_time() - due_us;
+            job->stats.runs++;
+            job->stats.total_jitter_us += jitter;
+            if (jitter > job->stats.max_jitter_us) job->stats.max_jitter_us = jitter;
+            job->func(job->arg);
+        }
+        arm_timer();
+    }
+    vTaskDelete(NULL);
+}
+
+static void stats_job(void * args){
+    scheduler_show_stats();
+}
+
+void config_scheduler(){
+    const esp_timer_create_args_t timer_args = {
+        .callback = &tick_timer_callback,
+        .name = "Scheduler timer"
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &tick_timer));
+    start_us = esp_timer_get_time();
+    // Prioridad y núcleo de la tabla de tareas
+    struct task_plan_entry plan = task_plan_get(TASK_PLAN_SCHEDULER);
+#if CONFIG_STATIC_ALLOCATION
+    scheduler_task_handle = xTaskCreateStaticPinnedToCore(scheduler_task, "Scheduler task", SCHEDULER_TASK_STACK_SIZE, NULL,
+                                                          plan.priority, scheduler_task_stack, &scheduler_task_buffer, plan.core);
+#else
+    xTaskCreatePinnedToCore(scheduler_task, "Scheduler task", SCHEDULER_TASK_STACK_SIZE, NULL, plan.priority,
+                            &scheduler_task_handle, plan.core);
+#endif
+    if (SCHEDULER_STATS_PERIOD_MS > 0){
+        scheduler_start_job(scheduler_add_job("stats", stats_job, NULL, SCHEDULER_STATS_PERIOD_MS, 0));
+    }
+}
+
+int scheduler_add_job(const char * name, scheduler_job_fn func, void * arg, uint32_t period_ms, uint32_t phase_ms){
+    portENTER_CRITICAL(&jobs_lock);
+    if (num_jobs == SCHEDULER_MAX_JOBS){
+        portEXIT_CRITICAL(&jobs_lock);
+        ESP_LOGE(TAG, "No room for job %s", name);
+        return -1;
+    }
+    struct scheduler_job * job = &jobs[num_jobs];
+    job->name = name;
+    job->func = func;
+    job->arg = arg;
+    job->period = ms_to_ticks(period_ms);
+    job->phase = phase_ms / SCHEDULER_TICK_MS;
+    job->running = false;
+    int id = num_jobs++;
+    portEXIT_CRITICAL(&jobs_lock);
+    return id;
+}
+
+void scheduler_start_job(int job){
+    if (job < 0 || job >= num_jobs) return;
+    uint32_t tick = current_tick();
+    portENTER_CRITICAL(&jobs_lock);
+    jobs[job].next = next_aligned_tick(&jobs[job], tick);
+    jobs[job].running = true;
+    portEXIT_CRITICAL(&jobs_lock);
+    // La tarea del planificador vuelve a calcular para cuándo armar el timer
+    xTaskNotifyGive(scheduler_task_handle);
+}
+
+void scheduler_stop_job(int job){
+    if (job < 0 || job >= num_jobs) return;
+    portENTER_CRITICAL(&jobs_lock);
+    jobs[job].running = false;
+    portEXIT_CRITICAL(&jobs_lock);
+    xTaskNotifyGive(scheduler_task_handle);
+}
+
+void scheduler_set_period(int job, uint32_t period_ms){
+    if (job < 0 || job >= num_jobs) return;
+    uint32_t tick = current_tick();
+    portENTER_CRITICAL(&jobs_lock);
+    jobs[job].period = ms_to_ticks(period_ms);
+    // La siguiente ejecución pasa al siguiente instante alineado con el nuevo periodo
+    if (jobs[job].running) jobs[job].next = next_aligned_tick(&jobs[job], tick);
+    portEXIT_CRITICAL(&jobs_lock);
+    xTaskNotifyGive(scheduler_task_handle);
+}
+
+void scheduler_get_stats(int job, struct scheduler_job_stats * stats){
+    if (job < 0 || job >= num_jobs) return;
+    portENTER_CRITICAL(&jobs_lock);
+    *stats = jobs[job].stats;
+    portEXIT_CRITICAL(&jobs_lock);
+}
+
+void scheduler_show_stats(){
+    for (int i = 0; i < num_jobs; i++){
+        struct scheduler_job_stats stats;
+        scheduler_get_stats(i, &stats);
+        ESP_LOGI(TAG, "%-10s period %u ms: %u runs, %u overruns, jitter mean %lld us max %lld us", jobs[i].name,
+                 jobs[i].period * SCHEDULER_TICK_MS, stats.runs, stats.overruns,
+                 stats.runs > 0 ? stats.total_jitter_us / stats.runs : 0, stats.max_jitter_us);
+    }
+}
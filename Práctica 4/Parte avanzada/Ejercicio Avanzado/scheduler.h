@@ -0,0 +1,37 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+#include <stdint.h>
+#include <stdbool.h>
+
+// Función de un trabajo periódico (la misma forma que el callback de un esp_timer)
+typedef void (* scheduler_job_fn)(void * arg);
+
+// Estadísticas de un trabajo
+struct scheduler_job_stats {
+    // Ejecuciones y periodos perdidos porque la ejecución anterior (o de otro trabajo) se alargó demasiado
+    uint32_t runs;
+    uint32_t overruns;
+    // Retraso entre el instante previsto y el real de cada ejecución (suma y máximo)
+    int64_t total_jitter_us;
+    int64_t max_jitter_us;
+};
+
+/* Prepara el planificador: un único timer que se arma para el siguiente tick en el que haya algún trabajo
+pendiente y una tarea que ejecuta los trabajos. Hay que llamarlo antes de añadir trabajos.*/
+void config_scheduler();
+/* Añade un trabajo (parado) que se ejecuta cada "period_ms" con un desfase "phase_ms". Periodo y desfase se
+redondean al tick del planificador y los instantes de ejecución son los múltiplos del periodo más el desfase
+contados desde un origen común, así que los trabajos con periodos compatibles coinciden en el mismo tick.
+Devuelve el identificador del trabajo o -1 si no caben más.*/
+int scheduler_add_job(const char * name, scheduler_job_fn func, void * arg, uint32_t period_ms, uint32_t phase_ms);
+// Arranca un trabajo (su primera ejecución será en el siguiente instante que le corresponda)
+void scheduler_start_job(int job);
+// Para un trabajo
+void scheduler_stop_job(int job);
+// Cambia el periodo de un trabajo (se puede llamar desde el propio trabajo)
+void scheduler_set_period(int job, uint32_t period_ms);
+// Copia las estadísticas de un trabajo
+void scheduler_get_stats(int job, struct scheduler_job_stats * stats);
+// Muestra por el puerto serie las estadísticas de todos los trabajos
+void scheduler_show_stats();
+#endif
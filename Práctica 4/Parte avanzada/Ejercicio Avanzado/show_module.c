@@ -7,9 +7,18 @@
 #include "distance_sampling.h"
 #include "hall_sampling.h"
 #include "binary_counter_3bits.h"
+#include "task_plan.h"
+
+// Pila de la tarea que muestra los datos
+#define SHOW_TASK_STACK_SIZE CONFIG_SHOW_TASK_STACK_SIZE
 
 // TAG para lo mensjaes de logging correspondientes a este fichero
 static const char* TAG = "Show Module";
+#if CONFIG_STATIC_ALLOCATION
+// Memoria de la tarea que muestra los datos, reservada en tiempo de enlazado
+static StackType_t show_task_stack[SHOW_TASK_STACK_SIZE];
+static StaticTask_t show_task_buffer;
+#endif
 
 // Tarea que lee de la cola donde los demás módulos ponen los datos y muestra la información por el puerto serie
 static void show_data_task(void * args);
@@ -67,8 +76,15 @@ static void show_event_handler(void* handler_args, esp_event_base_t base, int32_
 }
 
 void config_show_module(){
-    // Creamos para leer de la cola y escribir adecuadamente por el puerto serie
-    xTaskCreate(show_data_task, "Show data task", 2048, NULL, uxTaskPriorityGet(NULL), NULL);
+    /* Creamos para leer de la cola y escribir adecuadamente por el puerto serie (con la prioridad y el
+    núcleo de la tabla de tareas)*/
+    struct task_plan_entry plan = task_plan_get(TASK_PLAN_SHOW);
+#if CONFIG_STATIC_ALLOCATION
+    xTaskCreateStaticPinnedToCore(show_data_task, "Show data task", SHOW_TASK_STACK_SIZE, NULL, plan.priority,
+                                  show_task_stack, &show_task_buffer, plan.core);
+#else
+    xTaskCreatePinnedToCore(show_data_task, "Show data task", SHOW_TASK_STACK_SIZE, NULL, plan.priority, NULL, plan.core);
+#endif
     // La configuración del módulo consiste en registrar el handler para todos los eventos de base SHOW_EVENT
     ESP_ERROR_CHECK(esp_event_handler_register_with(event_loop, SHOW_EVENT, ESP_EVENT_ANY_ID, show_event_handler, NULL));
 }
\ No newline at end of file
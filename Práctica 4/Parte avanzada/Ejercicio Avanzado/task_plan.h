@@ -0,0 +1,29 @@
+#ifndef TASK_PLAN_H
+#define TASK_PLAN_H
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+/* Tareas de la aplicación. La prioridad y el núcleo de cada una salen de una única tabla configurable
+(menuconfig): el planificador de muestreo y el botón en la APP CPU y la salida por el puerto serie en la
+PRO CPU.*/
+enum task_plan_id {
+    // Tarea del planificador que ejecuta los trabajos periódicos
+    TASK_PLAN_SCHEDULER,
+    // Tarea que muestra los datos
+    TASK_PLAN_SHOW,
+    // Tarea del botón
+    TASK_PLAN_BUTTON,
+    // Tarea del bucle de eventos
+    TASK_PLAN_EVENT_LOOP,
+    TASK_PLAN_NUM
+};
+
+// Prioridad y núcleo de una tarea (tskNO_AFFINITY si puede ejecutarse en cualquiera)
+struct task_plan_entry {
+    UBaseType_t priority;
+    BaseType_t core;
+};
+
+// Devuelve la prioridad y el núcleo de una tarea
+struct task_plan_entry task_plan_get(enum task_plan_id id);
+#endif
@@ -1,16 +1,18 @@
 #include "distance_event.h"
+#include "task_plan.h"
 
 // Definimos la base de eventos "mostrar"
 ESP_EVENT_DEFINE_BASE(DISTANCE_EVENT);
 
 void config_event(){
-    // Preparamos los argumentos del bucle de eventos
+    // Preparamos los argumentos del bucle de eventos (prioridad y núcleo de la tabla de tareas)
+    struct task_plan_entry plan = task_plan_get(TASK_PLAN_EVENT_LOOP);
     esp_event_loop_args_t event_loop_args = {
         .queue_size = 5,
         .task_name = "loop_task", // task will be created
-        .task_priority = uxTaskPriorityGet(NULL),
+        .task_priority = plan.priority,
         .task_stack_size = 2048,
-        .task_core_id = tskNO_AFFINITY
+        .task_core_id = plan.core
     };
     // Configuramos el bucle de eventos con dichos argumentos
     ESP_ERROR_CHECK(esp_event_loop_create(&event_loop_args, &event_loop));
@@ -3,27 +3,57 @@
 #include "si7021.h"
 #include "hall.h"
 #include "LEDs.h"
+#include "dispatcher.h"
+#include "adaptive_rate.h"
+#include "budget_timer.h"
+#include "task_plan.h"
 #include "FSM.h"
 
-// Macros con los periodos de muestreo de sensores y salida por pantalla en segundos
+/* Macros con los periodos de muestreo de sensores en segundos: el que se usa cuando los detectores saltan
+y el máximo al que se alarga cuando las lecturas son estables*/
 #define PERIOD_HALL_SEC CONFIG_PERIOD_HALL_SEC
+#define PERIOD_HALL_MAX_SEC CONFIG_PERIOD_HALL_MAX_SEC
 #define PERIOD_TEMP_SEC CONFIG_PERIOD_TEMP_SEC
+#define PERIOD_TEMP_MAX_SEC CONFIG_PERIOD_TEMP_MAX_SEC
+// Muestras estables seguidas tras las que se duplica el periodo de muestreo
+#define ADAPTIVE_STABLE_SAMPLES CONFIG_ADAPTIVE_STABLE_SAMPLES
+// Macro con el periodo de salida por pantalla en segundos
 #define PERIOD_SHOW_SEC CONFIG_PERIOD_SHOW_SEC
 // Macro para el periodo de parpadeo de LEDs en milisegundos
 #define PERIOD_BLINK_MS CONFIG_PERIOD_BLINK_MS
+// LEDs encendidos cuando la temperatura es la de referencia (los que enciende init_leds)
+#define LEDS_AT_REF_TEMP 1
+// Presupuesto del callback del timer del paso del tiempo (solo publica un evento)
+#define TIME_TIMER_BUDGET_US 100
+// Longitud de la cola de entrada y pila de la tarea de la lógica
+#define FSM_QUEUE_LEN CONFIG_FSM_QUEUE_LEN
+#define FSM_TASK_STACK_SIZE CONFIG_FSM_TASK_STACK_SIZE
 
 static const char * TAG = "FSM";
 
+// Controladores del periodo de muestreo de cada sensor (en segundos transcurridos de la FSM)
+static struct adaptive_rate hall_rate;
+static struct adaptive_rate temp_rate;
+#if CONFIG_STATIC_ALLOCATION
+// Memoria de la cola de entrada y de la tarea de la lógica, reservada en tiempo de enlazado
+static uint8_t inputs_storage[DISPATCHER_QUEUE_STORAGE_SIZE(FSM_QUEUE_LEN)];
+static StaticQueue_t inputs_buffer;
+static StackType_t logic_task_stack[FSM_TASK_STACK_SIZE];
+static StaticTask_t logic_task_buffer;
+#endif
+
 // Posibles estamos de la máquina
 enum StateFSM{
     NORMAL_MODE,
     HALL_ALTERED_MODE
 };
 
-// Inicializa los módulos (sensores y leds) que utiliza la FSM y registra un manejador para los eventos que envíen
+// Inicializa los módulos (sensores y leds) que utiliza la FSM y suscribe su cola a los eventos que envíen
 static void init_modules_and_events();
-// Manejador para los eventos que generan los sensores que utiliza la FSM
-static void sensor_event_handler(void* handler_args, esp_event_base_t base, int32_t id, void* event_data);
+// Traduce un evento del dispatcher al mensaje de entrada de la FSM. Devuelve false si no es para la FSM
+static bool event_to_message(const struct dispatcher_event * event, struct MessageFSM * message);
+// Muestra la frecuencia de rotación que indica un mensaje HALL_ROTATION
+static void show_rotation(struct MessageFSM * message);
 // Funcion para inicializar y arrancar el paso del tiempo de la FSM
 static void FSM_time_start();
 // Callback para el timer que avisa periódicamente del paso del tiempo a la FSM
@@ -32,112 +62,116 @@ static void timer_callback(void * args);
 static void FSM_logic_task(void * args);
 // Función que contiene la lógica de la máquina en el modo normal y devuelve el siguiente estado
 static enum StateFSM normal_mode_logic(struct MessageFSM * message, unsigned int * elapsed_sec, int * hall_accum,
-                                       size_t * hall_count, float * temp_accum, size_t * temp_count, int * last_hall_normal_mode);
+                                       size_t * hall_count, float * temp_accum, size_t * temp_count);
 // Función que contiene la lógica de la máquina en el modo de hall alterado y devuelve el siguiente estado
 static enum StateFSM hall_altered_mode_logic(struct MessageFSM * message, unsigned int * elapsed_sec, int * hall_accum,
-                                       size_t * hall_count, int last_hall_normal_mode);
+                                       size_t * hall_count);
 
 void FSM_init_and_start(){
-    // Inicializamos la cola de entrada con 10 posiciones para punteros a estructuras con mensajes
-    inputs_FSM = xQueueCreate( 10, sizeof(struct MessageFSM *));
-    // Inicializamos los módulos de los sensores y leds, y resgitramos los handler para los eventos que emitan 
+    // Inicializamos la cola de entrada para eventos del dispatcher (se copian por valor)
+#if CONFIG_STATIC_ALLOCATION
+    inputs_FSM = dispatcher_create_queue_static(FSM_QUEUE_LEN, inputs_storage, &inputs_buffer);
+#else
+    inputs_FSM = dispatcher_create_queue(FSM_QUEUE_LEN);
+#endif
+    // Los sensores empiezan a muestrearse con su periodo mínimo (el tiempo de la FSM empieza en 0)
+    adaptive_rate_init(&hall_rate, PERIOD_HALL_SEC, PERIOD_HALL_MAX_SEC, ADAPTIVE_STABLE_SAMPLES, 0);
+    adaptive_rate_init(&temp_rate, PERIOD_TEMP_SEC, PERIOD_TEMP_MAX_SEC, ADAPTIVE_STABLE_SAMPLES, 0);
+    // Inicializamos los módulos de los sensores y leds, y suscribimos la cola a los eventos que emitan 
     init_modules_and_events();
     // Inicializamos y arracamos la información de tiempo que recibirá la FSM
     FSM_time_start();
-    // Iniciamos la lógica de la FSM
-    xTaskCreate(FSM_logic_task, "FSM_logic_task", 2048, NULL, uxTaskPriorityGet(NULL), NULL);
+    // Iniciamos la lógica de la FSM (con la prioridad y el núcleo de la tabla de tareas)
+    struct task_plan_entry plan = task_plan_get(TASK_PLAN_FSM);
+#if CONFIG_STATIC_ALLOCATION
+    xTaskCreateStaticPinnedToCore(FSM_logic_task, "FSM_logic_task", FSM_TASK_STACK_SIZE, NULL, plan.priority,
+                                  logic_task_stack, &logic_task_buffer, plan.core);
+#else
+    xTaskCreatePinnedToCore(FSM_logic_task, "FSM_logic_task", FSM_TASK_STACK_SIZE, NULL, plan.priority, NULL, plan.core);
+#endif
 }
 
 static void init_modules_and_events(){
+    /* Suscribimos la cola de la FSM a los eventos del paso del tiempo y de los sensores antes de
+    inicializarlos: los eventos llegan directamente a ella, sin tareas de bucle de eventos intermedias*/
+    dispatcher_subscribe(DISPATCHER_SOURCE_TIMER, inputs_FSM);
+    dispatcher_subscribe(DISPATCHER_SOURCE_SI7021, inputs_FSM);
+    dispatcher_subscribe(DISPATCHER_SOURCE_HALL, inputs_FSM);
     // Inicializamos el sensor de temperatura y humedad
     si7021_init();
     // Inicializamos el sensor de efecto hall
     hall_init();
+#if CONFIG_HALL_FFT_ENABLE
+    // Arrancamos las capturas para detectar la frecuencia de rotación
+    hall_fft_start();
+#endif
     // Inicializamos la gestión de LEDs por lo pines
     init_leds();
-    // Registramos un manejador para los eventos que genere el sensor de temperatura y humedad
-    ESP_ERROR_CHECK(esp_event_handler_register_with(si7021_event_loop, SI7021_EVENT, ESP_EVENT_ANY_ID, sensor_event_handler, NULL));
-    // Registramos el mismo manejador para los evenetos que genere el sensor de efecto hall
-    ESP_ERROR_CHECK(esp_event_handler_register_with(hall_event_loop, HALL_EVENT, ESP_EVENT_ANY_ID, sensor_event_handler, NULL));
 }
 
 static void FSM_time_start(){
     // Timer para el paso del tiempo
-    esp_timer_handle_t periodic_timer;
-    // Preparemos los argumentos del timer periódico
-    const esp_timer_create_args_t periodic_timer_args = {
+    budget_timer_handle_t periodic_timer;
+    /* Preparemos los argumentos del timer periódico. Se mide su callback contra el presupuesto y, si se
+    alarga, pasa a la tarea de trabajo para no retrasar al resto de timers.*/
+    const struct budget_timer_args periodic_timer_args = {
         .callback = &timer_callback,
-        .name = " Periodic timer"
+        .name = "Periodic timer",
+        .budget_us = TIME_TIMER_BUDGET_US,
+        .mode = BUDGET_TIMER_AUTO
     };
     // Configuramos el timer con los mencionados argumentos.
-    ESP_ERROR_CHECK(esp_timer_create(&periodic_timer_args, &periodic_timer));
+    ESP_ERROR_CHECK(budget_timer_create(&periodic_timer_args, &periodic_timer));
     // Iniciamos el timer con un periodo de 1 segundo
-    ESP_ERROR_CHECK(esp_timer_start_periodic(periodic_timer, 1000000));
+    ESP_ERROR_CHECK(budget_timer_start_periodic(periodic_timer, 1000000));
 }
 
 static void timer_callback(void * args){
-    // Reservamos memoria en el heap para un mensaje de entrada a la FSM
-    struct MessageFSM * message = (struct MessageFSM *) malloc(sizeof(struct MessageFSM));
-    // Indicamos con el tipo de mensaje que ha pasado un segundo
-    message->type = ONE_SEC_ELAPSED;
-    // No necesitamos el dato para comunicar nada a la máquina
-    message->data = NULL;
-    /* Colocamos un puntero al mensaje como entrada de la FSM (si la cola estuviese llena, 
-    asumimos que se pierda el mensaje y se intente un segundo más tarde)*/
-    xQueueSendToBack(inputs_FSM, &message, 0);
+    /* Indicamos a la FSM que ha pasado un segundo (si la cola estuviese llena, asumimos que se
+    pierda el mensaje y se intente un segundo más tarde)*/
+    dispatcher_post(DISPATCHER_SOURCE_TIMER, ONE_SEC_ELAPSED, 0, 0);
 }
 
-
-static void sensor_event_handler(void* handler_args, esp_event_base_t base, int32_t id, void* event_data){
-    // Reservamos espacio para un mensaje con el que informar a la FSM del evento recibido
-    struct MessageFSM * message = (struct MessageFSM *) malloc(sizeof(struct MessageFSM));
-    // Si es un evento del sensor de temperatura y humedad
-    if (base == SI7021_EVENT){
-        switch (id){
-            // Si nos avisan del incremento de un grado
-            case SI7021_EVENT_ONE_DEGREE_UP:
-                // Colocamos el tipo de mensaje que informa de ello
-                message->type = ONE_DEGREE_UP;
-                break;
-            // Si nos avisan del decremento de un grado
-            case SI7021_EVENT_ONE_DEGREE_DOWN:
-                // Colocamos el tipo de mensaje que informa de ello
-                message->type = ONE_DEGREE_DOWN;
-                break;
-            default:
-                break;
-        }
-        // Los mensajes de este sensor no tienen datos asociados
-        message->data = NULL;
-    }
-    // Si es un evento del sensor de efecto hall
-    else if(base == HALL_EVENT){
-        switch (id){
-            // Si nos informan de la alteración de los valores normales en el sensor
-            case HALL_EVENT_VALUES_ALTERED:
-                // Colocamos el tipo de mensaje que informa de ello
-                message->type = HALL_ALTERED;
-                // Reservamos espacio en el heap para un dato de tipo entero
-                message->data = (int*) malloc(sizeof(int));
-                /* Colocamos el dato recibido con el evento (la última medida normal antes de la alteración)
-                como dato del mensaje*/
-                *((int*)message->data) = *((int*) event_data);
-                break;
-            default:
-                break;
-        }
-    }
-    // Si es otro mensaje no lo atendemos
-    else return;
-    // Enviamos el mensaje construido a la FSM
-    if(xQueueSendToBack(inputs_FSM, &message, pdMS_TO_TICKS(200)) != pdTRUE){
-        ESP_LOGE(TAG, "Input queue FSM was full 200 ms and can't event message");
+static bool event_to_message(const struct dispatcher_event * event, struct MessageFSM * message){
+    // Los mensajes solo llevan dato cuando se indica a continuación
+    message->data = 0;
+    switch (event->source){
+        // El paso del tiempo ya se emite con el tipo de mensaje de la FSM
+        case DISPATCHER_SOURCE_TIMER:
+            message->type = event->id;
+            return true;
+        // Si es un evento del sensor de temperatura y humedad
+        case DISPATCHER_SOURCE_SI7021:
+            if (event->id != SI7021_EVENT_DEGREE_CHANGED) return false;
+            message->type = DEGREE_CHANGED;
+            // El dato lleva el nuevo nivel y el salto en grados (DISPATCHER_LEVEL_DATA)
+            message->data = event->data;
+            return true;
+        // Si es un evento del sensor de efecto hall
+        case DISPATCHER_SOURCE_HALL:
+            if (event->id == HALL_EVENT_VALUES_ALTERED) message->type = HALL_ALTERED;
+            else if (event->id == HALL_EVENT_VALUES_NORMAL) message->type = HALL_NORMAL;
+            else if (event->id == HALL_EVENT_ROTATION) message->type = HALL_ROTATION;
+            else return false;
+            // El dato del evento es la línea base de las medidas normales (o la frecuencia de rotación)
+            message->data = event->data;
+            return true;
+        // Si es otro evento no lo atendemos
+        default:
+            return false;
     }
 }
 
+static void show_rotation(struct MessageFSM * message){
+    unsigned int freq_dhz = HALL_ROTATION_FREQ_DHZ(message->data);
+    ESP_LOGI(TAG, "Rotation at %u.%u Hz (%u rpm), magnitude %u", freq_dhz / 10, freq_dhz % 10, freq_dhz * 6,
+             HALL_ROTATION_MAGNITUDE(message->data));
+}
+
 static void FSM_logic_task(void * args){
-    // Variable para guardar el mensaje que leamos de la cola de entrada
-    struct MessageFSM * message;
+    // Variables para el evento que leamos de la cola de entrada y el mensaje que representa
+    struct dispatcher_event event;
+    struct MessageFSM message;
     // Variable con el estado de la máquina (empieza en estado normal)
     enum StateFSM state = NORMAL_MODE;
     // Variable para saber el tiempo transcurrido
@@ -148,31 +182,26 @@ static void FSM_logic_task(void * args){
     // Variable con el número de valores acumulados de temperatura y hall
     size_t hall_count = 0;
     size_t temp_count = 0;
-    /* Variable para guardar el último valor de efecto hall en modo normal
-    antes de pasar al modo alterado. */
-    int last_hall_normal_mode;
     while(1){
         // Esperamos hasta recibir un mensaje de entrada de la cola
-        while(xQueueReceive(inputs_FSM, &message, portMAX_DELAY ) != pdTRUE);
+        while(xQueueReceive(inputs_FSM, &event, portMAX_DELAY ) != pdTRUE);
+        // Si el evento no es una entrada de la FSM lo ignoramos
+        if (!event_to_message(&event, &message)) continue;
         switch (state){
             // Si estamos en el modo normal
             case NORMAL_MODE:
                 // Desarrollamos la lógica del estado normal y actualizamos el estado comod dicha lógica indique
-                state = normal_mode_logic(message, &elapsed_sec, &hall_accum, &hall_count, &temp_accum, &temp_count, &last_hall_normal_mode);
+                state = normal_mode_logic(&message, &elapsed_sec, &hall_accum, &hall_count, &temp_accum, &temp_count);
                 break;
             // Si estamos en el estado de efecto hall alterado
             case HALL_ALTERED_MODE:
                 // Desarrollamos la lógica del estado normal y actualizamos el estado comod dicha lógica indique
-                state = hall_altered_mode_logic(message, &elapsed_sec, &hall_accum, &hall_count, last_hall_normal_mode);
+                state = hall_altered_mode_logic(&message, &elapsed_sec, &hall_accum, &hall_count);
                 break;
             // En otro estado no hacemos nada
             default:
                 break;
         }
-        // Liberamos la memoria correspondiente al dato del mensjae recibido (si la había)
-        if(message->data != NULL) free(message->data);
-        // Liberamos la memoria dinámica correspondiente al mensaje
-        free(message);
     }
     // Nunca saldrá del bucle infinito, pero es buena práctica poner un delete de la tarea al final
     vTaskDelete(NULL);
@@ -180,7 +209,7 @@ static void FSM_logic_task(void * args){
 
 
 static enum StateFSM normal_mode_logic(struct MessageFSM * message, unsigned int * elapsed_sec, int * hall_accum,
-                                       size_t * hall_count, float * temp_accum, size_t * temp_count, int * last_hall_normal_mode){
+                                       size_t * hall_count, float * temp_accum, size_t * temp_count){
     // Salvo que se cambie en la lógica sucesiva el siguiente estado volverá a ser el normal
     enum StateFSM state = NORMAL_MODE;
      // Miramos el tipo de mensaje
@@ -189,59 +218,65 @@ static enum StateFSM normal_mode_logic(struct MessageFSM * message, unsigned int
         case ONE_SEC_ELAPSED:
             // Aumentamos el número de segundos transcurridos
             (*elapsed_sec)++;
-            /* Si el tiempo transcurrido es múltiplo del periodo de muestreo del hall.
-            (Parece un poco absurdo comprobar si es múltiplo de 1, pero así es independiente
-            del valor de la macro)*/
-            if(*elapsed_sec % PERIOD_HALL_SEC == 0){
+            // Si toca muestrear el hall según su periodo actual
+            if(adaptive_rate_due(&hall_rate, *elapsed_sec)){
                 /* Leemos el valor del sensor con chequeo de su variación respecto a la lectura
                 anterior y lo acumulamos.*/
                 *hall_accum += get_hall_value_check_variation();
                 // Contabilizamos el valor acumulado
                 (*hall_count)++;
+                /* La contamos como estable: si el detector ha saltado, el evento HALL_ALTERED que
+                llega a continuación devuelve el periodo al mínimo*/
+                adaptive_rate_stable(&hall_rate);
             }
-            // Si el tiempo transucrrido es múltiplo del periodo de muestreo de temperatura
-            if (*elapsed_sec % PERIOD_TEMP_SEC == 0){
+            // Si toca muestrear la temperatura según su periodo actual
+            if (adaptive_rate_due(&temp_rate, *elapsed_sec)){
                 /* Leemos la temperatura con chequeo de diferencia respecto a la primera lectura
                 y lo acumulamos*/
                 *temp_accum += si7021_get_temp_and_check_diff(true);
                 // Contabilizamos el valor acumulado
                 (*temp_count)++;
+                // Igual que el hall: un evento DEGREE_CHANGED devolverá el periodo al mínimo
+                adaptive_rate_stable(&temp_rate);
             }
             // Si el tiempo transcurrido es múltiplo del periodo de salida por pantalla
             if (*elapsed_sec % PERIOD_SHOW_SEC == 0){
-                // Mostramos la media de los valores de los vectores
-                ESP_LOGI(TAG, "Mean hall: %f", (float) *hall_accum / *hall_count);
-                ESP_LOGI(TAG, "Mean temperature: %.2f ºC", *temp_accum / *temp_count);
+                /* Mostramos la media de los valores de los vectores (con periodos de muestreo largos
+                puede no haber ninguna muestra en el intervalo)*/
+                if (*hall_count > 0) ESP_LOGI(TAG, "Mean hall: %f", (float) *hall_accum / *hall_count);
+                if (*temp_count > 0) ESP_LOGI(TAG, "Mean temperature: %.2f ºC", *temp_accum / *temp_count);
                 // Reseteamos los acumuladores y contadores
                 *hall_accum = 0; *hall_count = 0;
                 *temp_accum = 0; *temp_count = 0;
             }
             break;
-        // Si nos indica el aumento de un grado más respecto a la temperatura inicial
-        case ONE_DEGREE_UP:
-            // Mandamos encender un LED más 
-            turn_on_one_led();
-            // Informamos del aumento por el puerto serie
-            ESP_LOGI(TAG, "One more degree");
-            break;
-        // Si nos indica la perdida de un grado más respecto a lo que estamos representando
-        case ONE_DEGREE_DOWN:
-            // Mandamos apagar un LED
-            turn_off_one_led();
-            // Informamos del decremento por el puerto serie
-            ESP_LOGI(TAG, "One less degree");
+        // Si nos indica que ha cambiado la diferencia en grados enteros respecto a la temperatura inicial
+        case DEGREE_CHANGED:
+            /* Con la temperatura inicial hay un LED encendido y uno más o menos por cada grado de diferencia:
+            colocamos directamente ese nivel, aunque se hayan cruzado varios grados a la vez*/
+            set_leds_level(LEDS_AT_REF_TEMP + DISPATCHER_EVENT_LEVEL(message->data));
+            // La temperatura está cambiando: volvemos a muestrearla con el periodo mínimo
+            adaptive_rate_activity(&temp_rate, *elapsed_sec);
+            // Informamos del cambio por el puerto serie
+            ESP_LOGI(TAG, "%+d degrees (%+d from reference)", DISPATCHER_EVENT_DELTA(message->data),
+                     DISPATCHER_EVENT_LEVEL(message->data));
             break;
         // Si nos indica que los valores del sensor de efecto hall se han alterado
         case HALL_ALTERED:
-            /* Extramos el dato del mensaje con el último valor "normal" del sensor y lo guardamos
-            en nuestra variable local */
-            *last_hall_normal_mode = *((int *) message->data);
+            /* Durante el modo alterado el hall se muestrea con el periodo mínimo para detectar
+            cuanto antes la vuelta a valores normales*/
+            adaptive_rate_activity(&hall_rate, *elapsed_sec);
             // Iniciamos el parapadeo de LEDs
             start_blink(PERIOD_BLINK_MS);
             // Informamos del cambio de modo
-            ESP_LOGI(TAG, "Entering hall altered mode");
+            ESP_LOGI(TAG, "Entering hall altered mode (baseline %d)", message->data);
             // Transitamos al estado alterado
             state = HALL_ALTERED_MODE;
+            break;
+        // Si nos indica la frecuencia de rotación detectada en el hall
+        case HALL_ROTATION:
+            show_rotation(message);
+            break;
         // En cualquier otro caso no hacemos nada
         default:
             break;
@@ -251,7 +286,7 @@ static enum StateFSM normal_mode_logic(struct MessageFSM * message, unsigned int
 }
 
 static enum StateFSM hall_altered_mode_logic(struct MessageFSM * message, unsigned int * elapsed_sec, int * hall_accum,
-                                       size_t * hall_count, int last_hall_normal_mode){
+                                       size_t * hall_count){
     // Salvo que se cambie en la lógica sucesiva el siguiente estado volverá a ser el alterado
     enum StateFSM state = HALL_ALTERED_MODE;
     // Miramos el tipo de mensaje
@@ -260,35 +295,38 @@ static enum StateFSM hall_altered_mode_logic(struct MessageFSM * message, unsign
         case ONE_SEC_ELAPSED:
             // Aumentamos el número de segundos transcurridos
             (*elapsed_sec)++;
-            // Si el tiempo transcurrido es mútiplo del periodo de muestreo del sensor hall
-            if(*elapsed_sec % PERIOD_HALL_SEC == 0){
-                /* Leemos un valor del sensor sin comprobación de alteración y acumulamos su valor.
-                Como estamos en el modo alterado los mensajes de alteración no tienen sentido y
-                podemos directamente evitar generarlos (ahorrando también eventos innecesarios)*/
-                int hall_val = get_hall_value();
-                *hall_accum += hall_val;
+            /* Si toca muestrear el sensor hall (en este modo no se anotan muestras estables,
+            así que el periodo se mantiene en el mínimo)*/
+            if(adaptive_rate_due(&hall_rate, *elapsed_sec)){
+                /* Leemos un valor del sensor y lo acumulamos. El detector sigue comprobando las lecturas
+                y avisará con HALL_NORMAL cuando vuelvan a estar cerca de la línea base durante el
+                tiempo mínimo de permanencia*/
+                *hall_accum += get_hall_value_check_variation();
                 // Contabilizamos el valor acumulado
                 (*hall_count)++;
-                /* Si el valor leído vuelve a ser normal (varía como mucho un 20% respecto al
-                último valor normal)*/
-                if (abs(last_hall_normal_mode - hall_val) <= 0.2 * abs(last_hall_normal_mode)){
-                    /* Paramos el parpadeo de los LEDs (se volverán a mostrar en función de la
-                    temperatura como antes de entrar a este modo)*/
-                    stop_blink();
-                    // Volvemos al modo normal
-                    state =  NORMAL_MODE;
-                    // Informamos por el puerto serie
-                    ESP_LOGI(TAG, "Return to normal mode");
-                }
             }
             // Si el tiempo transucrrido es mútiplo de mostrar las medias
             if (*elapsed_sec % PERIOD_SHOW_SEC == 0){
                 // Mostramos la media de hall
-                ESP_LOGI(TAG, "Mean hall: %f", (float) *hall_accum / *hall_count);
+                if (*hall_count > 0) ESP_LOGI(TAG, "Mean hall: %f", (float) *hall_accum / *hall_count);
                 // Reseteamos el acumulador y el contador
                 *hall_accum = 0; *hall_count = 0;
             }
             break;
+        // Si el detector indica que los valores del sensor han vuelto a ser normales
+        case HALL_NORMAL:
+            /* Paramos el parpadeo de los LEDs (se volverán a mostrar en función de la
+            temperatura como antes de entrar a este modo)*/
+            stop_blink();
+            // Volvemos al modo normal
+            state =  NORMAL_MODE;
+            // Informamos por el puerto serie
+            ESP_LOGI(TAG, "Return to normal mode");
+            break;
+        // La rotación se informa igual en ambos modos
+        case HALL_ROTATION:
+            show_rotation(message);
+            break;
         default:
             break;
     }
@@ -3,26 +3,26 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
 
-// Cola para enviar entradas a la FSM
+// Cola con los eventos de entrada a la FSM (struct dispatcher_event, se suscribe a todos los orígenes del dispatcher)
 QueueHandle_t inputs_FSM;
 
 // Posibles tipos de mensajes que recibe la máquina
 enum MessageTypeFSM{
     ONE_SEC_ELAPSED,
-    ONE_DEGREE_UP,
-    ONE_DEGREE_DOWN,
-    HALL_ALTERED
+    DEGREE_CHANGED,
+    HALL_ALTERED,
+    HALL_NORMAL,
+    HALL_ROTATION
 };
 
 // Estructura de un mensaje de entrada a la FSM
 struct MessageFSM{
     // Tipo de mensaje
     enum MessageTypeFSM type;
-    /* Dato incluido en mensaje. Solo la utilizamos para enviar el
-    último valor que fue "normal" en los mensaje que informan de una
-    alteración en el valor del hall. De esta forma la FSM podrá volver
-    al modo normal cuando se recuperen valores parecidos al último que lo era.*/
-    void * data;
+    /* Dato incluido en mensaje. En los mensajes del hall es la línea base de los
+    valores normales del sensor (en HALL_ROTATION, la frecuencia y magnitud del pico).
+    En DEGREE_CHANGED lleva los grados de diferencia y el salto (DISPATCHER_LEVEL_DATA).*/
+    int data;
 };
 
 // Inicializa las estructuras, eventos y lógica de la FSM
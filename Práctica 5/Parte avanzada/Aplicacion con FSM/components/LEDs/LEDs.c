@@ -1,21 +1,27 @@
 #include <freertos/FreeRTOS.h>
 #include <driver/gpio.h>
 #include <esp_log.h>
+#include "gpio_port.h"
+#include "budget_timer.h"
 #include "LEDs.h"
 // Macros para los pines de salida utilizados para los LEDs
 #define GPIO_OUTPUT_0 CONFIG_GPIO_OUTPUT_0
 #define GPIO_OUTPUT_1 CONFIG_GPIO_OUTPUT_1
 #define GPIO_OUTPUT_2 CONFIG_GPIO_OUTPUT_2
 #define GPIO_OUTPUT_3 CONFIG_GPIO_OUTPUT_3
-// Máscara para la selección de los pines de salida
-#define GPIO_OUTPUT_PIN_SEL (1ULL<<GPIO_OUTPUT_0 | 1ULL<<GPIO_OUTPUT_1 | 1ULL<<GPIO_OUTPUT_2 | 1ULL<<GPIO_OUTPUT_3)
+// Número de LEDs de la barra
+#define NUM_LEDS 4
+// Presupuesto del callback de parpadeo (una escritura del puerto)
+#define BLINK_BUDGET_US 50
 
-// Array con los pines de los LEDs (lo usaremos para encender el siguiente cuando queramos encender uno más)
-static const int OUTPUT_PINS[] = {GPIO_OUTPUT_0, GPIO_OUTPUT_1, GPIO_OUTPUT_2, GPIO_OUTPUT_3};
+// Array con los pines de los LEDs (el primero es el que se enciende primero)
+static const gpio_num_t OUTPUT_PINS[NUM_LEDS] = {GPIO_OUTPUT_0, GPIO_OUTPUT_1, GPIO_OUTPUT_2, GPIO_OUTPUT_3};
+// Puerto de salida con un bit por LED
+static struct gpio_port leds_port;
 // Variable para llevar el número de leds encendidos
 static int num_leds_on;
 // Timer para el parpadeo de leds
-static esp_timer_handle_t blink_timer;
+static budget_timer_handle_t blink_timer;
 
 // Coloca el valor de salida para encender/apagar los leds según indica el contador de leds que hay que encender
 static void set_leds();
@@ -23,13 +29,12 @@ static void set_leds();
 static void blink_timer_callback(void * args);
 
 static void set_leds(){
-    // Iterando tantas posiciones como leds
-    for (int i = 0; i < sizeof(OUTPUT_PINS) / sizeof(int); i++){
-        // Calculamos si el leds de esa posición debe encenderse o no según el contador de leds que deben estar encendidos
-        bool led_state = (i < num_leds_on);
-        // En dicho led escribimos la salida que lo encienda/apague según corresponda
-        ESP_ERROR_CHECK(gpio_set_level(OUTPUT_PINS[i], led_state));
-    }
+    // Los "num_leds_on" primeros LEDs encendidos: los bits bajos del puerto a 1
+    uint32_t value = 0;
+    if (num_leds_on >= NUM_LEDS) value = (1UL << NUM_LEDS) - 1;
+    else if (num_leds_on > 0) value = (1UL << num_leds_on) - 1;
+    // Escribimos todos los LEDs a la vez
+    gpio_port_write(&leds_port, value);
 }
 
 /* Hace un parpadeo del tipo: todos encendidos-todos apagados porque el enunciado no
@@ -37,41 +42,28 @@ dice cómo debe ser el parpadeo y esta es la forma más fácil. */
 static void blink_timer_callback(void * args){
     // Variable para llevar la salida que toca en los leds en cada llamada al callback
     static int leds_level = 0;
-    // Iterando tantas posiciones como leds
-    for (int i = 0; i < sizeof(OUTPUT_PINS) / sizeof(int); i++){
-        // Colocamos el nivel de salida en el correspondiente led
-        ESP_ERROR_CHECK(gpio_set_level(OUTPUT_PINS[i], leds_level));
-    }
+    // Colocamos el nivel de salida en todos los leds a la vez
+    gpio_port_write(&leds_port, leds_level ? (1UL << NUM_LEDS) - 1 : 0);
     // Cambiamos el nivel de los leds para la siguiente llamada al callback
     leds_level = (leds_level + 1) % 2;
 }
 
 void init_leds(){
-    // Variable para la configuración de pines GPIO
-    gpio_config_t io_conf = {};
-    // Deshabilitamos las interrupciones (de hecho al ser de salida no tiene sentido habilitar interrupciones)
-    io_conf.intr_type = GPIO_INTR_DISABLE;
-    // Establecemos los pines para salida
-    io_conf.mode = GPIO_MODE_OUTPUT;
-    // Colocamos la máscara con los pines afectados por esta configuración
-    io_conf.pin_bit_mask = GPIO_OUTPUT_PIN_SEL;
-    // Deshabilitamos el pull-down
-    io_conf.pull_down_en = 0;
-    // Deshabilitamos el pull-up
-    io_conf.pull_up_en = 0;
-    // Establecemos la configuración
-    gpio_config(&io_conf);
+    // Configuramos los pines de los LEDs como salida y preparamos el puerto
+    ESP_ERROR_CHECK(gpio_port_init(&leds_port, OUTPUT_PINS, NUM_LEDS));
     // Encendemos inicialmente un LED
     num_leds_on = 1;
     set_leds();
 
     // Preparemos los argumentos del timer periódico para el muestreo.
-    const esp_timer_create_args_t periodic_timer_args = {
+    const struct budget_timer_args periodic_timer_args = {
         .callback = &blink_timer_callback,
-        .name = "Sampling timer"
+        .name = "Blink timer",
+        .budget_us = BLINK_BUDGET_US,
+        .mode = BUDGET_TIMER_AUTO
     };
     // Configuramos el timer con los mencionados argumentos. (Sin iniciarlo, hay otro método para ello)
-    ESP_ERROR_CHECK(esp_timer_create(&periodic_timer_args, &blink_timer));
+    ESP_ERROR_CHECK(budget_timer_create(&periodic_timer_args, &blink_timer));
 }
 
 void turn_on_one_led(){
@@ -88,14 +80,21 @@ void turn_off_one_led(){
     set_leds();
 }
 
+void set_leds_level(int level){
+    // Colocamos directamente el contador de leds que deben encenderse
+    num_leds_on = level;
+    // Una sola escritura del puerto para el nuevo nivel
+    set_leds();
+}
+
 void start_blink(unsigned int period){
     // Arrancamos el timer que hará parpadear los leds
-    ESP_ERROR_CHECK(esp_timer_start_periodic(blink_timer, period * 1000));
+    ESP_ERROR_CHECK(budget_timer_start_periodic(blink_timer, period * 1000));
 }
 
 void stop_blink(){
     // Paramos el timer de parpadeo de leds
-    ESP_ERROR_CHECK(esp_timer_stop(blink_timer));
+    ESP_ERROR_CHECK(budget_timer_stop(blink_timer));
     // Ordenamos reescribir el nivel de esos leds según el valor contador
     set_leds();
 }
\ No newline at end of file
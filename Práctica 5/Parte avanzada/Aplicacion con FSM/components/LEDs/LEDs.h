@@ -7,6 +7,8 @@ void init_leds();
 void turn_on_one_led();
 // Apagado de un led más
 void turn_off_one_led();
+// Encendido de los "level" primeros leds y apagado del resto (de una vez, sin pasar por los niveles intermedios)
+void set_leds_level(int level);
 // Inicio del parapadeo de leds con el periodo recibido como parámetro
 void start_blink(unsigned int period);
 // Finalización del parpadeo de leds
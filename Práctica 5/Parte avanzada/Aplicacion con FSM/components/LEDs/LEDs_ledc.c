@@ -0,0 +1,154 @@
+#include <freertos/FreeRTOS.h>
+#include <driver/ledc.h>
+#include <esp_sleep.h>
+#include <esp_log.h>
+#include "LEDs.h"
+// Macros para los pines de salida utilizados para los LEDs
+#define GPIO_OUTPUT_0 CONFIG_GPIO_OUTPUT_0
+#define GPIO_OUTPUT_1 CONFIG_GPIO_OUTPUT_1
+#define GPIO_OUTPUT_2 CONFIG_GPIO_OUTPUT_2
+#define GPIO_OUTPUT_3 CONFIG_GPIO_OUTPUT_3
+// Número de LEDs de la barra
+#define NUM_LEDS 4
+// Duración del fundido al encender o apagar un LED
+#define LEDS_FADE_MS CONFIG_LEDS_FADE_MS
+// Brillo de un LED encendido (en tanto por ciento)
+#define LEDS_BRIGHTNESS CONFIG_LEDS_BRIGHTNESS
+
+// Modo del periférico LEDC: el de baja velocidad puede usar el reloj RTC8M, que sigue activo en light sleep
+#define LEDS_SPEED_MODE LEDC_LOW_SPEED_MODE
+// Timer del PWM de brillo (frecuencia alta, no se aprecia parpadeo) y su resolución
+#define LEDS_TIMER LEDC_TIMER_0
+#define LEDS_FREQ_HZ 1000
+#define LEDS_RESOLUTION LEDC_TIMER_10_BIT
+// Timer del parpadeo: un PWM de muy baja frecuencia con ciclo de trabajo del 50 %
+#define BLINK_TIMER LEDC_TIMER_1
+// Frecuencia del reloj RTC8M con el que funcionan los timers
+#define RTC8M_FREQ_HZ 8000000ULL
+// Límites del divisor de los timers (número en punto fijo con 8 bits decimales)
+#define TIMER_DIV_MIN (1 << 8)
+#define TIMER_DIV_MAX ((1 << 18) - 1)
+
+static const char* TAG = "LEDs";
+// Array con los pines de los LEDs (el primero es el que se enciende primero)
+static const int OUTPUT_PINS[NUM_LEDS] = {GPIO_OUTPUT_0, GPIO_OUTPUT_1, GPIO_OUTPUT_2, GPIO_OUTPUT_3};
+// Variable para llevar el número de leds encendidos
+static int num_leds_on;
+// Indica si los LEDs están parpadeando (conectados al timer de parpadeo)
+static bool blinking = false;
+
+// Ciclo de trabajo de un LED encendido con el timer de brillo
+static uint32_t on_duty();
+// Lleva cada LED al nivel que le corresponde según el contador de LEDs encendidos (con fundido si "fade")
+static void set_leds(bool fade);
+// Configura el timer de parpadeo para alternar encendido/apagado cada "period" ms
+static void config_blink_timer(unsigned int period);
+
+
+static uint32_t on_duty(){
+    return ((1 << LEDS_RESOLUTION) - 1) * LEDS_BRIGHTNESS / 100;
+}
+
+static void set_leds(bool fade){
+    for (int i = 0; i < NUM_LEDS; i++){
+        uint32_t duty = i < num_leds_on ? on_duty() : 0;
+        /* El fundido lo hace el hardware: la CPU solo programa el destino y la duración.
+        Solo se funde el LED que cambia; los demás ya tienen su ciclo de trabajo.*/
+        if (fade && ledc_get_duty(LEDS_SPEED_MODE, i) != duty) {
+            ESP_ERROR_CHECK(ledc_set_fade_time_and_start(LEDS_SPEED_MODE, i, duty, LEDS_FADE_MS, LEDC_FADE_NO_WAIT));
+        }
+        else {
+            ESP_ERROR_CHECK(ledc_set_duty_and_update(LEDS_SPEED_MODE, i, duty, 0));
+        }
+    }
+}
+
+static void config_blink_timer(unsigned int period){
+    /* El periodo del PWM es el doble del periodo de parpadeo (encendido "period" ms y apagado otros tantos).
+    ledc_timer_config() solo admite frecuencias enteras, así que programamos el divisor directamente, con la
+    mayor resolución que deje el divisor dentro de rango: divisor = RTC8M / (frecuencia * 2^resolución).*/
+    uint64_t div_by_res = RTC8M_FREQ_HZ * 256 * 2 * period / 1000;
+    int resolution = LEDC_TIMER_20_BIT;
+    while (resolution > LEDC_TIMER_1_BIT && (div_by_res >> resolution) < TIMER_DIV_MIN) resolution--;
+    uint64_t div = div_by_res >> resolution;
+    if (div > TIMER_DIV_MAX) {
+        ESP_LOGW(TAG, "Blink period %u ms too long for LEDC, using the longest possible", period);
+        div = TIMER_DIV_MAX;
+    }
+    ESP_ERROR_CHECK(ledc_timer_set(LEDS_SPEED_MODE, BLINK_TIMER, div, resolution, LEDC_APB_CLK));
+    ESP_ERROR_CHECK(ledc_timer_rst(LEDS_SPEED_MODE, BLINK_TIMER));
+    // Todos los LEDs a la mitad del periodo del timer de parpadeo: se encienden y apagan a la vez
+    for (int i = 0; i < NUM_LEDS; i++){
+        ESP_ERROR_CHECK(ledc_bind_channel_timer(LEDS_SPEED_MODE, i, BLINK_TIMER));
+        ESP_ERROR_CHECK(ledc_set_duty_and_update(LEDS_SPEED_MODE, i, 1 << (resolution - 1), 0));
+    }
+}
+
+void init_leds(){
+    /* Timers de brillo y de parpadeo. Ambos usan el reloj RTC8M para que el PWM (y con él el parpadeo)
+    siga funcionando sin la CPU también en light sleep.*/
+    ledc_timer_config_t timer_conf = {
+        .speed_mode = LEDS_SPEED_MODE,
+        .duty_resolution = LEDS_RESOLUTION,
+        .timer_num = LEDS_TIMER,
+        .freq_hz = LEDS_FREQ_HZ,
+        .clk_cfg = LEDC_USE_RTC8M_CLK
+    };
+    ESP_ERROR_CHECK(ledc_timer_config(&timer_conf));
+    // El timer de parpadeo se configura con una frecuencia válida cualquiera; su divisor se ajusta al parpadear
+    timer_conf.timer_num = BLINK_TIMER;
+    ESP_ERROR_CHECK(ledc_timer_config(&timer_conf));
+    ESP_ERROR_CHECK(esp_sleep_pd_config(ESP_PD_DOMAIN_RTC8M, ESP_PD_OPTION_ON));
+    // Un canal por LED, inicialmente apagado y conectado al timer de brillo
+    for (int i = 0; i < NUM_LEDS; i++){
+        ledc_channel_config_t channel_conf = {
+            .speed_mode = LEDS_SPEED_MODE,
+            .channel = i,
+            .timer_sel = LEDS_TIMER,
+            .intr_type = LEDC_INTR_DISABLE,
+            .gpio_num = OUTPUT_PINS[i],
+            .duty = 0,
+            .hpoint = 0
+        };
+        ESP_ERROR_CHECK(ledc_channel_config(&channel_conf));
+    }
+    // Servicio de fundidos por hardware
+    ESP_ERROR_CHECK(ledc_fade_func_install(0));
+    // Encendemos inicialmente un LED
+    num_leds_on = 1;
+    set_leds(false);
+}
+
+void turn_on_one_led(){
+    // Aumentamos el contador de leds que deben encenderse
+    num_leds_on++;
+    // Mientras parpadean no se cambia nada; se aplicará el contador al parar el parpadeo
+    if (!blinking) set_leds(true);
+}
+
+void turn_off_one_led(){
+    // Disminuimos el contador de leds que deben encenderse
+    num_leds_on--;
+    if (!blinking) set_leds(true);
+}
+
+void set_leds_level(int level){
+    num_leds_on = level;
+    // Un solo repaso de los canales: se funden a la vez todos los LEDs que cambian
+    if (!blinking) set_leds(true);
+}
+
+void start_blink(unsigned int period){
+    // El parpadeo lo genera el timer LEDC: no hay ningún timer software que despierte a la CPU
+    config_blink_timer(period);
+    blinking = true;
+}
+
+void stop_blink(){
+    // Volvemos a conectar los LEDs al timer de brillo y aplicamos el valor del contador
+    for (int i = 0; i < NUM_LEDS; i++){
+        ESP_ERROR_CHECK(ledc_bind_channel_timer(LEDS_SPEED_MODE, i, LEDS_TIMER));
+    }
+    blinking = false;
+    set_leds(false);
+}
@@ -0,0 +1,52 @@
+#include <stdlib.h>
+#include "anomaly_detector.h"
+
+// Umbral de desviación para un porcentaje de la base dado
+static int32_t threshold(const struct anomaly_detector * detector, uint8_t pct);
+
+
+static int32_t threshold(const struct anomaly_detector * detector, uint8_t pct){
+    int32_t limit = abs(anomaly_detector_baseline(detector)) * pct / 100;
+    return limit > detector->min_deviation ? limit : detector->min_deviation;
+}
+
+void anomaly_detector_init(struct anomaly_detector * detector, int32_t initial, uint8_t alpha_shift, uint8_t enter_pct,
+                           uint8_t exit_pct, int32_t min_deviation, uint16_t dwell_samples){
+    detector->baseline_q8 = initial * 256;
+    detector->alpha_shift = alpha_shift;
+    detector->enter_pct = enter_pct;
+    // La salida nunca puede ser más exigente que la entrada
+    detector->exit_pct = exit_pct < enter_pct ? exit_pct : enter_pct;
+    detector->min_deviation = min_deviation;
+    detector->dwell_samples = dwell_samples;
+    detector->samples_in_state = 0;
+    detector->altered = false;
+}
+
+int32_t anomaly_detector_baseline(const struct anomaly_detector * detector){
+    return (detector->baseline_q8 + 128) >> 8;
+}
+
+enum anomaly_transition anomaly_detector_update(struct anomaly_detector * detector, int32_t sample){
+    int32_t deviation = abs(sample - anomaly_detector_baseline(detector));
+    if (detector->samples_in_state < UINT16_MAX) detector->samples_in_state++;
+    bool dwell_done = detector->samples_in_state >= detector->dwell_samples;
+    if (!detector->altered){
+        if (deviation > threshold(detector, detector->enter_pct)){
+            // Las muestras anómalas no entran en la base: se queda con el último comportamiento normal
+            if (!dwell_done) return ANOMALY_NONE;
+            detector->altered = true;
+            detector->samples_in_state = 0;
+            return ANOMALY_ENTER;
+        }
+        // Media móvil exponencial: base += (muestra - base) / 2^alpha_shift
+        detector->baseline_q8 += (sample * 256 - detector->baseline_q8) >> detector->alpha_shift;
+        return ANOMALY_NONE;
+    }
+    if (dwell_done && deviation <= threshold(detector, detector->exit_pct)){
+        detector->altered = false;
+        detector->samples_in_state = 0;
+        return ANOMALY_EXIT;
+    }
+    return ANOMALY_NONE;
+}
@@ -0,0 +1,40 @@
+#ifndef ANOMALY_DETECTOR_H
+#define ANOMALY_DETECTOR_H
+#include <stdint.h>
+#include <stdbool.h>
+
+// Cambios de estado que puede indicar el detector tras una muestra
+enum anomaly_transition {
+    ANOMALY_NONE,
+    ANOMALY_ENTER,
+    ANOMALY_EXIT
+};
+
+/* Detector de anomalías sobre una línea base con media móvil exponencial, todo en aritmética entera.
+Se entra en anomalía cuando una muestra se aleja de la base más de "enter_pct" % y se sale cuando vuelve
+a estar a menos de "exit_pct" % (exit_pct < enter_pct da la histéresis). Además hay que pasar al menos
+"dwell_samples" muestras en un estado antes de poder cambiar a otro. Mientras dura la anomalía la base
+se congela, de forma que la salida se compara con el último comportamiento normal.*/
+struct anomaly_detector {
+    // Línea base en punto fijo con 8 bits decimales
+    int32_t baseline_q8;
+    // Peso de cada muestra en la base: 1 / 2^alpha_shift
+    uint8_t alpha_shift;
+    uint8_t enter_pct;
+    uint8_t exit_pct;
+    // Desviación mínima en unidades de la muestra (para bases cercanas a 0, donde el porcentaje no sirve)
+    int32_t min_deviation;
+    uint16_t dwell_samples;
+    // Muestras que llevamos en el estado actual
+    uint16_t samples_in_state;
+    bool altered;
+};
+
+// Prepara el detector en estado normal con "initial" como línea base
+void anomaly_detector_init(struct anomaly_detector * detector, int32_t initial, uint8_t alpha_shift, uint8_t enter_pct,
+                           uint8_t exit_pct, int32_t min_deviation, uint16_t dwell_samples);
+// Procesa una muestra y devuelve si provoca la entrada o la salida del estado de anomalía
+enum anomaly_transition anomaly_detector_update(struct anomaly_detector * detector, int32_t sample);
+// Devuelve la línea base redondeada a unidades de la muestra
+int32_t anomaly_detector_baseline(const struct anomaly_detector * detector);
+#endif
@@ -0,0 +1,220 @@
+#include <stdlib.h>
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include "budget_timer.h"
+#include "task_plan.h"
+
+// Violaciones seguidas tras las que un timer en modo automático pasa a la tarea de trabajo
+#define BUDGET_TIMER_AUTO_VIOLATIONS CONFIG_BUDGET_TIMER_AUTO_VIOLATIONS
+// Tiempo mínimo entre dos avisos de violación de un mismo timer
+#define BUDGET_TIMER_LOG_INTERVAL_US (CONFIG_BUDGET_TIMER_LOG_INTERVAL_MS * 1000LL)
+// Periodo con el que se muestran las estadísticas (0 para no mostrarlas)
+#define BUDGET_TIMER_REPORT_SEC CONFIG_BUDGET_TIMER_REPORT_SEC
+// Número máximo de timers y longitud de la cola de trabajos
+#define BUDGET_TIMER_MAX 8
+#define WORK_QUEUE_LEN BUDGET_TIMER_MAX
+// Pila de la tarea de trabajo
+#define BUDGET_TIMER_WORKER_STACK_SIZE CONFIG_BUDGET_TIMER_WORKER_STACK_SIZE
+
+static const char* TAG = "Budget timer";
+
+struct budget_timer {
+    esp_timer_handle_t timer;
+    struct budget_timer_args args;
+    // El cuerpo se ejecuta en la tarea de trabajo / hay un trabajo del timer en la cola
+    volatile bool offloaded;
+    volatile bool pending;
+    // Cambia con cada budget_timer_stop: los trabajos encolados antes de pararlo ya no se ejecutan
+    volatile uint32_t generation;
+    // Violaciones seguidas (para el modo automático)
+    uint32_t consecutive;
+    // Último aviso de violación y violaciones desde entonces sin avisar
+    int64_t last_log_us;
+    uint32_t unlogged;
+    portMUX_TYPE lock;
+    struct budget_timer_stats stats;
+};
+
+// Trabajo encolado: el timer y su generación en el momento del disparo
+struct work_item {
+    struct budget_timer * timer;
+    uint32_t generation;
+};
+
+// Timers creados (para el informe) y cola y tarea de trabajo
+static struct budget_timer * timers[BUDGET_TIMER_MAX];
+static int num_timers = 0;
+static QueueHandle_t work_queue;
+#if CONFIG_STATIC_ALLOCATION
+// Memoria de los timers, de la cola y de la tarea de trabajo, reservada en tiempo de enlazado
+static struct budget_timer timer_pool[BUDGET_TIMER_MAX];
+static uint8_t work_queue_storage[WORK_QUEUE_LEN * sizeof(struct work_item)];
+static StaticQueue_t work_queue_buffer;
+static StackType_t worker_stack[BUDGET_TIMER_WORKER_STACK_SIZE];
+static StaticTask_t worker_buffer;
+#endif
+
+// Callback de todos los esp_timer: ejecuta el cuerpo o lo encola
+static void dispatch_callback(void * args);
+// Ejecuta el cuerpo de un timer y mide su duración
+static void run_body(struct budget_timer * timer);
+// Anota la duración de una ejecución y trata las violaciones del presupuesto
+static void record_run(struct budget_timer * timer, int64_t elapsed_us);
+// Tarea de trabajo: ejecuta los cuerpos encolados y muestra periódicamente las estadísticas
+static void worker_task(void * args);
+
+
+static void dispatch_callback(void * args){
+    struct budget_timer * timer = (struct budget_timer *) args;
+    if (!timer->offloaded) {
+        run_body(timer);
+        return;
+    }
+    // Si el disparo anterior aún no se ha ejecutado no encolamos otro: la cola no crece con un cuerpo lento
+    if (!timer->pending) {
+        timer->pending = true;
+        struct work_item item = { .timer = timer, .generation = timer->generation };
+        if (xQueueSendToBack(work_queue, &item, 0) == pdTRUE) return;
+        timer->pending = false;
+    }
+    portENTER_CRITICAL(&timer->lock);
+    timer->stats.dropped++;
+    portEXIT_CRITICAL(&timer->lock);
+}
+
+static void run_body(struct budget_timer * timer){
+    int64_t start = esp_timer_get_time();
+    timer->args.callback(timer->args.arg);
+    record_run(timer, esp_timer_get_time() - start);
+}
+
+static void record_run(struct budget_timer * timer, int64_t elapsed_us){
+    bool violation = elapsed_us > timer->args.budget_us;
+    portENTER_CRITICAL(&timer->lock);
+    timer->stats.runs++;
+    timer->stats.total_us += elapsed_us;
+    if (elapsed_us > timer->stats.max_us) timer->stats.max_us = elapsed_us;
+    if (violation) timer->stats.violations++;
+    portEXIT_CRITICAL(&timer->lock);
+    if (!violation) {
+        timer->consecutive = 0;
+        return;
+    }
+    timer->consecutive++;
+    // Avisamos como mucho una vez por intervalo: el propio aviso por el puerto serie también lleva tiempo
+    int64_t now = esp_timer_get_time();
+    if (now - timer->last_log_us >= BUDGET_TIMER_LOG_INTERVAL_US) {
+        ESP_LOGW(TAG, "%s took %lld us (budget %u us, %u more violations since last warning)", timer->args.name,
+                 elapsed_us, timer->args.budget_us, timer->unlogged);
+        timer->last_log_us = now;
+        timer->unlogged = 0;
+    }
+    else {
+        timer->unlogged++;
+    }
+    if (timer->args.mode == BUDGET_TIMER_AUTO && !timer->offloaded && timer->consecutive >= BUDGET_TIMER_AUTO_VIOLATIONS) {
+        timer->offloaded = true;
+        timer->stats.offloaded = true;
+        ESP_LOGW(TAG, "%s moved to the worker task", timer->args.name);
+    }
+}
+
+static void worker_task(void * args){
+    TickType_t wait = BUDGET_TIMER_REPORT_SEC > 0 ? pdMS_TO_TICKS(BUDGET_TIMER_REPORT_SEC * 1000) : portMAX_DELAY;
+    TickType_t last_report = xTaskGetTickCount();
+    struct work_item item;
+    while(1){
+        if (xQueueReceive(work_queue, &item, wait) == pdTRUE) {
+            // Si el timer se ha parado desde el disparo, el cuerpo ya no debe ejecutarse
+            if (item.generation == item.timer->generation) run_body(item.timer);
+            item.timer->pending = false;
+        }
+        if (BUDGET_TIMER_REPORT_SEC > 0 && xTaskGetTickCount() - last_report >= wait) {
+            budget_timer_show_stats();
+            last_report = xTaskGetTickCount();
+        }
+    }
+    vTaskDelete(NULL);
+}
+
+esp_err_t budget_timer_create(const struct budget_timer_args * args, budget_timer_handle_t * out_handle){
+    if (num_timers == BUDGET_TIMER_MAX) return ESP_ERR_NO_MEM;
+    // La cola y la tarea de trabajo se crean con el primer timer
+    if (work_queue == NULL) {
+        // Prioridad (menor que la de los esp_timer para no retrasar sus disparos) y núcleo de la tabla de tareas
+        struct task_plan_entry plan = task_plan_get(TASK_PLAN_BUDGET_WORKER);
+#if CONFIG_STATIC_ALLOCATION
+        work_queue = xQueueCreateStatic(WORK_QUEUE_LEN, sizeof(struct work_item), work_queue_storage, &work_queue_buffer);
+        xTaskCreateStaticPinnedToCore(worker_task, "Budget timer worker", BUDGET_TIMER_WORKER_STACK_SIZE, NULL,
+                                      plan.priority, worker_stack, &worker_buffer, plan.core);
+#else
+        work_queue = xQueueCreate(WORK_QUEUE_LEN, sizeof(struct work_item));
+        if (work_queue == NULL) return ESP_ERR_NO_MEM;
+        if (xTaskCreatePinnedToCore(worker_task, "Budget timer worker", BUDGET_TIMER_WORKER_STACK_SIZE, NULL,
+                                    plan.priority, NULL, plan.core) != pdPASS) {
+            vQueueDelete(work_queue);
+            work_queue = NULL;
+            return ESP_ERR_NO_MEM;
+        }
+#endif
+    }
+#if CONFIG_STATIC_ALLOCATION
+    struct budget_timer * timer = &timer_pool[num_timers];
+#else
+    struct budget_timer * timer = calloc(1, sizeof(struct budget_timer));
+    if (timer == NULL) return ESP_ERR_NO_MEM;
+#endif
+    timer->args = *args;
+    timer->offloaded = args->mode == BUDGET_TIMER_OFFLOAD;
+    timer->stats.offloaded = timer->offloaded;
+    portMUX_INITIALIZE(&timer->lock);
+    const esp_timer_create_args_t timer_args = {
+        .callback = &dispatch_callback,
+        .arg = timer,
+        .name = args->name
+    };
+    esp_err_t err = esp_timer_create(&timer_args, &timer->timer);
+    if (err != ESP_OK) {
+#if !CONFIG_STATIC_ALLOCATION
+        free(timer);
+#endif
+        return err;
+    }
+    timers[num_timers++] = timer;
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+esp_err_t budget_timer_start_periodic(budget_timer_handle_t timer, uint64_t period_us){
+    return esp_timer_start_periodic(timer->timer, period_us);
+}
+
+esp_err_t budget_timer_start_once(budget_timer_handle_t timer, uint64_t timeout_us){
+    return esp_timer_start_once(timer->timer, timeout_us);
+}
+
+esp_err_t budget_timer_stop(budget_timer_handle_t timer){
+    esp_err_t err = esp_timer_stop(timer->timer);
+    // Descarta el disparo que pudiera estar esperando en la cola de la tarea de trabajo
+    timer->generation++;
+    return err;
+}
+
+void budget_timer_get_stats(budget_timer_handle_t timer, struct budget_timer_stats * stats){
+    portENTER_CRITICAL(&timer->lock);
+    *stats = timer->stats;
+    portEXIT_CRITICAL(&timer->lock);
+}
+
+void budget_timer_show_stats(){
+    for (int i = 0; i < num_timers; i++){
+        struct budget_timer_stats stats;
+        budget_timer_get_stats(timers[i], &stats);
+        ESP_LOGI(TAG, "%s (%s): %u runs, mean %lld us, max %lld us, budget %u us, %u violations, %u dropped",
+                 timers[i]->args.name, stats.offloaded ? "worker" : "inline", stats.runs,
+                 stats.runs > 0 ? stats.total_us / stats.runs : 0, stats.max_us, timers[i]->args.budget_us,
+                 stats.violations, stats.dropped);
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef BUDGET_TIMER_H
+#define BUDGET_TIMER_H
+#include <stdint.h>
+#include <stdbool.h>
+#include <esp_err.h>
+#include <esp_timer.h>
+
+/* Dónde se ejecuta el cuerpo de un timer. Todos los callbacks de esp_timer comparten una tarea, así que uno
+lento retrasa a todos los demás; el trabajo pesado se puede llevar a una tarea de trabajo aparte.*/
+enum budget_timer_mode {
+    // En la tarea de los esp_timer (solo se mide); para lo que no admite el retraso de la tarea de trabajo
+    BUDGET_TIMER_INLINE,
+    // Siempre en la tarea de trabajo: el callback del esp_timer solo encola el trabajo
+    BUDGET_TIMER_OFFLOAD,
+    // En línea hasta que supera el presupuesto CONFIG_BUDGET_TIMER_AUTO_VIOLATIONS veces seguidas
+    BUDGET_TIMER_AUTO
+};
+
+// Argumentos de creación de un timer con presupuesto
+struct budget_timer_args {
+    esp_timer_cb_t callback;
+    void * arg;
+    const char * name;
+    // Tiempo máximo de ejecución del cuerpo (us)
+    uint32_t budget_us;
+    enum budget_timer_mode mode;
+};
+
+// Estadísticas de un timer
+struct budget_timer_stats {
+    // Ejecuciones del cuerpo y las que han superado el presupuesto
+    uint32_t runs;
+    uint32_t violations;
+    // Disparos descartados porque la tarea de trabajo aún no había ejecutado el anterior
+    uint32_t dropped;
+    // Tiempo de ejecución del cuerpo (suma y máximo)
+    int64_t total_us;
+    int64_t max_us;
+    // Indica si el cuerpo se ejecuta en la tarea de trabajo
+    bool offloaded;
+};
+
+typedef struct budget_timer * budget_timer_handle_t;
+
+// Crea un timer (parado) cuyo cuerpo se mide contra su presupuesto
+esp_err_t budget_timer_create(const struct budget_timer_args * args, budget_timer_handle_t * out_handle);
+// Arranca el timer de forma periódica o para un solo disparo (como esp_timer_start_periodic/once)
+esp_err_t budget_timer_start_periodic(budget_timer_handle_t timer, uint64_t period_us);
+esp_err_t budget_timer_start_once(budget_timer_handle_t timer, uint64_t timeout_us);
+/* Para el timer (se puede llamar desde su propio cuerpo). Un disparo que aún espera en la tarea de trabajo
+ya no se ejecuta, aunque el timer se vuelva a arrancar antes*/
+esp_err_t budget_timer_stop(budget_timer_handle_t timer);
+// Copia las estadísticas del timer
+void budget_timer_get_stats(budget_timer_handle_t timer, struct budget_timer_stats * stats);
+// Muestra por el puerto serie las estadísticas de todos los timers
+void budget_timer_show_stats();
+#endif
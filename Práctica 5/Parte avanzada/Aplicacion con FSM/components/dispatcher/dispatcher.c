@@ -0,0 +1,53 @@
+#include <esp_log.h>
+#include <esp_timer.h>
+#include "dispatcher.h"
+
+static const char* TAG = "dispatcher";
+// Cola del consumidor de cada origen de eventos (NULL si no hay ninguno)
+static QueueHandle_t consumers[DISPATCHER_NUM_SOURCES];
+
+
+QueueHandle_t dispatcher_create_queue(size_t length){
+    return xQueueCreate(length, sizeof(struct dispatcher_event));
+}
+
+QueueHandle_t dispatcher_create_queue_static(size_t length, uint8_t * storage, StaticQueue_t * buffer){
+    return xQueueCreateStatic(length, sizeof(struct dispatcher_event), storage, buffer);
+}
+
+void dispatcher_subscribe(enum dispatcher_source source, QueueHandle_t queue){
+    consumers[source] = queue;
+}
+
+esp_err_t dispatcher_post(enum dispatcher_source source, uint8_t id, int32_t data, TickType_t ticks_to_wait){
+    QueueHandle_t queue = consumers[source];
+    if (queue == NULL) return ESP_ERR_INVALID_STATE;
+    // El evento se construye en la pila y la cola lo copia: una sola copia y ningún cambio de contexto intermedio
+    struct dispatcher_event event = {
+        .source = source,
+        .id = id,
+        .data = data,
+        .time_us = esp_timer_get_time()
+    };
+    if (xQueueSendToBack(queue, &event, ticks_to_wait) != pdTRUE) return ESP_ERR_TIMEOUT;
+    return ESP_OK;
+}
+
+bool dispatcher_threshold_update(struct dispatcher_threshold * threshold, float value, enum dispatcher_source source, uint8_t id){
+    /* Nivel que correspondería al valor desplazado la histéresis hacia el nivel actual: subir exige pasar
+    el umbral superior en "hysteresis" y bajar quedar "hysteresis" por debajo del inferior*/
+    int level = threshold->level;
+    int up = (int) ((value - threshold->hysteresis) / threshold->step);
+    int down = (int) ((value + threshold->hysteresis) / threshold->step);
+    if (up > level) level = up;
+    else if (down < level) level = down;
+    if (level == threshold->level) return false;
+    // Un solo evento con el nivel nuevo y el salto, crucemos los umbrales que crucemos
+    int delta = level - threshold->level;
+    threshold->level = level;
+    if (dispatcher_post(source, id, DISPATCHER_LEVEL_DATA(level, delta), 0) != ESP_OK) {
+        // El siguiente cambio lleva el nivel absoluto, así que el consumidor se resincroniza con él
+        ESP_LOGE(TAG, "Queue full, level change to %d lost", level);
+    }
+    return true;
+}
@@ -0,0 +1,67 @@
+#ifndef DISPATCHER_H
+#define DISPATCHER_H
+#include <stdint.h>
+#include <stdbool.h>
+#include <esp_err.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+
+// Orígenes de los eventos que reparte el dispatcher
+enum dispatcher_source {
+    DISPATCHER_SOURCE_TIMER,
+    DISPATCHER_SOURCE_SI7021,
+    DISPATCHER_SOURCE_HALL,
+    DISPATCHER_NUM_SOURCES
+};
+
+/* Evento de tamaño fijo. Se copia por valor directamente en la cola del consumidor:
+no hay tarea intermedia ni memoria dinámica para el dato.*/
+struct dispatcher_event {
+    // Origen del evento y su identificador dentro de ese origen (p. ej. SI7021_EVENT_DEGREE_CHANGED)
+    uint8_t source;
+    uint8_t id;
+    // Dato asociado al evento (si el evento no tiene dato no se usa)
+    int32_t data;
+    // Instante (esp_timer) en que se emitió el evento
+    int64_t time_us;
+};
+
+/* Dato de un evento de umbral: el nuevo nivel en los 16 bits altos y el salto con signo respecto al
+nivel anterior en los 16 bajos (un solo evento aunque se crucen varios umbrales a la vez)*/
+#define DISPATCHER_LEVEL_DATA(level, delta) ((int32_t) (((uint32_t) (uint16_t) (int16_t) (level) << 16) | (uint16_t) (int16_t) (delta)))
+#define DISPATCHER_EVENT_LEVEL(data) ((int16_t) ((uint32_t) (data) >> 16))
+#define DISPATCHER_EVENT_DELTA(data) ((int16_t) ((uint32_t) (data) & 0xFFFF))
+
+/* Magnitud vigilada por umbrales equiespaciados. El nivel es el número entero de pasos "step" que hay
+en el valor (truncado hacia cero) y solo cambia cuando el valor supera el umbral en más de "hysteresis",
+para que una medida que oscila sobre un umbral no genere un evento en cada lectura.*/
+struct dispatcher_threshold {
+    float step;
+    float hysteresis;
+    // Nivel actual (inicialmente 0)
+    int level;
+};
+
+// Crea una cola de "length" eventos en la que un consumidor puede recibir eventos del dispatcher
+QueueHandle_t dispatcher_create_queue(size_t length);
+// Bytes de almacenamiento que necesita una cola de "length" eventos creada con dispatcher_create_queue_static
+#define DISPATCHER_QUEUE_STORAGE_SIZE(length) ((length) * sizeof(struct dispatcher_event))
+/* Igual que dispatcher_create_queue, pero sobre memoria que aporta el llamador: "storage" con
+DISPATCHER_QUEUE_STORAGE_SIZE(length) bytes y "buffer" para la estructura de la cola (no usa el heap)*/
+QueueHandle_t dispatcher_create_queue_static(size_t length, uint8_t * storage, StaticQueue_t * buffer);
+// Hace que los eventos del origen "source" se entreguen en la cola "queue" (creada con dispatcher_create_queue)
+void dispatcher_subscribe(enum dispatcher_source source, QueueHandle_t queue);
+/* Emite un evento del origen "source" a la cola de su consumidor, esperando como mucho "ticks_to_wait"
+si está llena. Devuelve ESP_ERR_INVALID_STATE si nadie se ha suscrito al origen y ESP_ERR_TIMEOUT si
+la cola sigue llena.*/
+esp_err_t dispatcher_post(enum dispatcher_source source, uint8_t id, int32_t data, TickType_t ticks_to_wait);
+/* Actualiza el nivel de "threshold" con "value" y, si cambia, emite un único evento "id" del origen
+"source" con DISPATCHER_LEVEL_DATA(nivel nuevo, salto), sin esperar si la cola está llena.
+Devuelve true si el nivel ha cambiado.*/
+bool dispatcher_threshold_update(struct dispatcher_threshold * threshold, float value, enum dispatcher_source source, uint8_t id);
+#if CONFIG_DISPATCHER_BENCHMARK
+/* Mide la latencia entre la emisión y la recepción de un evento con el dispatcher y con el camino anterior
+(bucle de esp_event con su tarea, manejador que reserva un mensaje y cola de la FSM) y muestra los resultados*/
+void dispatcher_benchmark();
+#endif
+#endif
@@ -0,0 +1,124 @@
+#include <stdlib.h>
+#include <esp_log.h>
+#include <esp_event.h>
+#include <esp_timer.h>
+#include <freertos/task.h>
+#include "dispatcher.h"
+
+// Número de eventos que se emiten por cada camino
+#define BENCH_EVENTS CONFIG_DISPATCHER_BENCHMARK_EVENTS
+// Longitud de las colas y tamaño de pila de las tareas (los mismos que usaban los sensores y la FSM)
+#define BENCH_QUEUE_LEN 10
+#define BENCH_STACK_SIZE 2048
+
+// Base de eventos para el camino anterior (bucle de esp_event)
+ESP_EVENT_DEFINE_BASE(BENCH_EVENT);
+
+static const char* TAG = "dispatcher bench";
+
+// Mensaje como el que construía el manejador de eventos de la FSM (con el dato en memoria dinámica)
+struct bench_message {
+    int type;
+    void * data;
+};
+// Tarea que emite los eventos (se le notifica cada recepción para emitir el siguiente)
+static TaskHandle_t producer;
+// Cola del consumidor en la prueba en curso
+static QueueHandle_t bench_queue;
+// Latencia acumulada y máxima de la prueba en curso
+static int64_t total_us;
+static int64_t max_us;
+
+// Anota la latencia de un evento emitido en "post_time" y avisa al productor
+static void record_latency(int64_t post_time);
+// Manejador del bucle de eventos: reproduce sensor_event_handler (reserva un mensaje y lo pasa a la cola)
+static void legacy_handler(void* handler_args, esp_event_base_t base, int32_t id, void* event_data);
+// Consumidor del camino anterior: recibe punteros a mensajes y los libera
+static void legacy_consumer_task(void * args);
+// Consumidor del dispatcher: recibe los eventos por valor
+static void dispatcher_consumer_task(void * args);
+// Muestra la media y el máximo de la prueba en curso
+static void show_result(const char * path);
+
+
+static void record_latency(int64_t post_time){
+    int64_t latency = esp_timer_get_time() - post_time;
+    total_us += latency;
+    if (latency > max_us) max_us = latency;
+    xTaskNotifyGive(producer);
+}
+
+static void legacy_handler(void* handler_args, esp_event_base_t base, int32_t id, void* event_data){
+    struct bench_message * message = (struct bench_message *) malloc(sizeof(struct bench_message));
+    message->type = id;
+    message->data = malloc(sizeof(int64_t));
+    *((int64_t *) message->data) = *((int64_t *) event_data);
+    xQueueSendToBack(bench_queue, &message, pdMS_TO_TICKS(200));
+}
+
+static void legacy_consumer_task(void * args){
+    struct bench_message * message;
+    for (int i = 0; i < BENCH_EVENTS; i++){
+        while(xQueueReceive(bench_queue, &message, portMAX_DELAY) != pdTRUE);
+        record_latency(*((int64_t *) message->data));
+        free(message->data);
+        free(message);
+    }
+    vTaskDelete(NULL);
+}
+
+static void dispatcher_consumer_task(void * args){
+    struct dispatcher_event event;
+    for (int i = 0; i < BENCH_EVENTS; i++){
+        while(xQueueReceive(bench_queue, &event, portMAX_DELAY) != pdTRUE);
+        record_latency(event.time_us);
+    }
+    vTaskDelete(NULL);
+}
+
+static void show_result(const char * path){
+    ESP_LOGI(TAG, "%s: mean latency %lld us, max %lld us (%d events)", path, total_us / BENCH_EVENTS, max_us, BENCH_EVENTS);
+}
+
+void dispatcher_benchmark(){
+    producer = xTaskGetCurrentTaskHandle();
+    // Todas las tareas con la prioridad de quien arranca la FSM, como el bucle de eventos y la tarea de la FSM
+    UBaseType_t priority = uxTaskPriorityGet(NULL);
+
+    // Camino anterior: esp_event_post_to -> tarea del bucle -> manejador con malloc -> cola -> tarea consumidora
+    esp_event_loop_handle_t loop;
+    esp_event_loop_args_t event_loop_args = {
+        .queue_size = 5,
+        .task_name = "bench_loop_task",
+        .task_priority = priority,
+        .task_stack_size = BENCH_STACK_SIZE,
+        .task_core_id = tskNO_AFFINITY
+    };
+    ESP_ERROR_CHECK(esp_event_loop_create(&event_loop_args, &loop));
+    ESP_ERROR_CHECK(esp_event_handler_register_with(loop, BENCH_EVENT, ESP_EVENT_ANY_ID, legacy_handler, NULL));
+    bench_queue = xQueueCreate(BENCH_QUEUE_LEN, sizeof(struct bench_message *));
+    total_us = 0; max_us = 0;
+    xTaskCreate(legacy_consumer_task, "bench_legacy", BENCH_STACK_SIZE, NULL, priority, NULL);
+    for (int i = 0; i < BENCH_EVENTS; i++){
+        int64_t now = esp_timer_get_time();
+        ESP_ERROR_CHECK(esp_event_post_to(loop, BENCH_EVENT, 0, &now, sizeof(now), pdMS_TO_TICKS(200)));
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    show_result("esp_event loop");
+    ESP_ERROR_CHECK(esp_event_loop_delete(loop));
+    vQueueDelete(bench_queue);
+
+    // Dispatcher: dispatcher_post -> cola -> tarea consumidora
+    bench_queue = dispatcher_create_queue(BENCH_QUEUE_LEN);
+    dispatcher_subscribe(DISPATCHER_SOURCE_TIMER, bench_queue);
+    total_us = 0; max_us = 0;
+    xTaskCreate(dispatcher_consumer_task, "bench_dispatcher", BENCH_STACK_SIZE, NULL, priority, NULL);
+    for (int i = 0; i < BENCH_EVENTS; i++){
+        ESP_ERROR_CHECK(dispatcher_post(DISPATCHER_SOURCE_TIMER, 0, 0, pdMS_TO_TICKS(200)));
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    show_result("dispatcher");
+    // Dejamos el origen libre para que se suscriba el consumidor real
+    dispatcher_subscribe(DISPATCHER_SOURCE_TIMER, NULL);
+    vQueueDelete(bench_queue);
+}
@@ -1,19 +1,29 @@
 #ifndef HALL_H
 #define HALL_H
-#include <esp_event.h>
-// Base de eventos asociados al sensor de efecto hall
-ESP_EVENT_DECLARE_BASE(HALL_EVENT);
-// Bucle para los eventos de este sensor
-esp_event_loop_handle_t hall_event_loop;
-// POsibles identificadores de eventos del sensor
+#include <stdint.h>
+#include <sdkconfig.h>
+// POsibles identificadores de eventos del sensor (se emiten con el origen DISPATCHER_SOURCE_HALL)
 enum {
-    HALL_EVENT_VALUES_ALTERED
+    HALL_EVENT_VALUES_ALTERED,
+    HALL_EVENT_VALUES_NORMAL,
+    HALL_EVENT_ROTATION
 };
+/* Dato de HALL_EVENT_ROTATION: frecuencia dominante en décimas de Hz en los 16 bits altos y su
+magnitud (amplitud en unidades del ADC) en los 16 bajos*/
+#define HALL_ROTATION_DATA(freq_dhz, magnitude) ((int32_t) (((uint32_t) (uint16_t) (freq_dhz) << 16) | (uint16_t) (magnitude)))
+#define HALL_ROTATION_FREQ_DHZ(data) ((uint16_t) ((uint32_t) (data) >> 16))
+#define HALL_ROTATION_MAGNITUDE(data) ((uint16_t) ((uint32_t) (data) & 0xFFFF))
 // Inicializa el sensor
 void hall_init();
-/* Devuelve un valor leído del sensor y comprueba si ha variado al menos un 20% respecto al anterior
-(emite un evento HALL_EVENT_VALUES_ALTERED en tal caso)*/
+/* Devuelve un valor leído del sensor y lo compara con la media móvil de las lecturas normales. Emite
+HALL_EVENT_VALUES_ALTERED al alejarse de ella más del umbral de entrada y HALL_EVENT_VALUES_NORMAL al volver
+por debajo del de salida, con la media como dato en ambos casos*/
 int get_hall_value_check_variation();
 // Devuelve un valor leído del sensor
 int get_hall_value();
+#if CONFIG_HALL_FFT_ENABLE
+/* Arranca las capturas periódicas de bloques de muestras a frecuencia fija. El espectro de cada bloque
+se calcula con una FFT y, si su pico supera la magnitud mínima, se emite HALL_EVENT_ROTATION*/
+void hall_fft_start();
+#endif
 #endif
\ No newline at end of file
@@ -0,0 +1,181 @@
+#include <math.h>
+#include <stdlib.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <driver/adc.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_cpu.h>
+#include <esp_heap_caps.h>
+#include "esp_dsp.h"
+#include "budget_timer.h"
+#include "dispatcher.h"
+#include "hall.h"
+#include "task_plan.h"
+
+// Número de muestras de cada captura (potencia de 2 para la FFT radix-2)
+#define HALL_FFT_SIZE CONFIG_HALL_FFT_SIZE
+// Frecuencia de muestreo de la captura
+#define HALL_FFT_RATE_HZ CONFIG_HALL_FFT_RATE_HZ
+// Tiempo entre capturas
+#define HALL_FFT_PERIOD_SEC CONFIG_HALL_FFT_PERIOD_SEC
+// Magnitud mínima (en unidades del ADC) del pico para considerar que hay rotación
+#define HALL_FFT_MIN_MAGNITUDE CONFIG_HALL_FFT_MIN_MAGNITUDE
+// Tamaño máximo de la FFT en la prueba de rendimiento
+#define HALL_FFT_BENCH_MAX_SIZE 4096
+// Pila de la tarea de la FFT
+#define HALL_FFT_TASK_STACK_SIZE CONFIG_HALL_FFT_TASK_STACK_SIZE
+
+static const char* TAG = "Hall FFT";
+
+/* Muestras de la captura en curso e instantes de la primera y la última (para calcular la
+frecuencia de muestreo real, que puede desviarse algo de la del timer)*/
+static float samples[HALL_FFT_SIZE];
+static volatile int num_samples;
+static int64_t first_sample_us;
+static int64_t last_sample_us;
+// Datos complejos de la FFT (parte real e imaginaria intercaladas) y ventana de Hann
+static float fft_data[2 * HALL_FFT_SIZE];
+static float window[HALL_FFT_SIZE];
+// Timer de la captura y tarea que calcula la FFT
+static budget_timer_handle_t capture_timer;
+static TaskHandle_t fft_task_handle;
+#if CONFIG_STATIC_ALLOCATION
+// Memoria de la tarea de la FFT, reservada en tiempo de enlazado
+static StackType_t fft_task_stack[HALL_FFT_TASK_STACK_SIZE];
+static StaticTask_t fft_task_buffer;
+#endif
+
+// Callback del timer de captura: toma una muestra y avisa a la tarea cuando el bloque está completo
+static void capture_timer_callback(void * args);
+// Tarea que lanza las capturas y analiza el espectro de cada una
+static void fft_task(void * args);
+/* Calcula el espectro de "n" muestras en "data" (2n floats) y devuelve el índice del pico (sin contar la
+continua) y su magnitud (amplitud de la componente en unidades de la muestra)*/
+static int spectrum_peak(const float * input, float * data, const float * win, int n, float * magnitude);
+#if CONFIG_HALL_FFT_BENCHMARK
+// Mide tiempo de CPU y memoria de la FFT para distintos tamaños
+static void fft_benchmark();
+#endif
+
+
+static void capture_timer_callback(void * args){
+    int64_t now = esp_timer_get_time();
+    if (num_samples == 0) first_sample_us = now;
+    last_sample_us = now;
+    samples[num_samples++] = hall_sensor_read();
+    if (num_samples == HALL_FFT_SIZE){
+        budget_timer_stop(capture_timer);
+        xTaskNotifyGive(fft_task_handle);
+    }
+}
+
+static int spectrum_peak(const float * input, float * data, const float * win, int n, float * magnitude){
+    // Señal real enventanada sin la media (la continua del hall no interesa)
+    float mean = 0;
+    for (int i = 0; i < n; i++) mean += input[i];
+    mean /= n;
+    for (int i = 0; i < n; i++){
+        data[2 * i] = (input[i] - mean) * win[i];
+        data[2 * i + 1] = 0;
+    }
+    // FFT radix-2 in situ y reordenación de bits
+    dsps_fft2r_fc32(data, n);
+    dsps_bit_rev_fc32(data, n);
+    // Buscamos el pico en la mitad positiva del espectro
+    int peak = 1;
+    float peak_power = 0;
+    for (int k = 1; k < n / 2; k++){
+        float power = data[2 * k] * data[2 * k] + data[2 * k + 1] * data[2 * k + 1];
+        if (power > peak_power){
+            peak_power = power;
+            peak = k;
+        }
+    }
+    // Amplitud: 2 |X[k]| / suma de la ventana (n / 2 para la de Hann)
+    *magnitude = 4 * sqrtf(peak_power) / n;
+    return peak;
+}
+
+static void fft_task(void * args){
+    while(1){
+        // Lanzamos una captura y esperamos a que el timer complete el bloque
+        num_samples = 0;
+        ESP_ERROR_CHECK(budget_timer_start_periodic(capture_timer, 1000000 / HALL_FFT_RATE_HZ));
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        float rate = (HALL_FFT_SIZE - 1) * 1000000.0f / (last_sample_us - first_sample_us);
+        float magnitude;
+        int peak = spectrum_peak(samples, fft_data, window, HALL_FFT_SIZE, &magnitude);
+        float frequency = peak * rate / HALL_FFT_SIZE;
+        ESP_LOGD(TAG, "Peak at %.1f Hz, magnitude %.1f (sampled at %.0f Hz)", frequency, magnitude, rate);
+        // Solo publicamos la rotación si el pico destaca lo suficiente
+        if (magnitude >= HALL_FFT_MIN_MAGNITUDE){
+            ESP_ERROR_CHECK_WITHOUT_ABORT(dispatcher_post(DISPATCHER_SOURCE_HALL, HALL_EVENT_ROTATION,
+                                                          HALL_ROTATION_DATA(lroundf(frequency * 10), lroundf(magnitude)), 0));
+        }
+        vTaskDelay(pdMS_TO_TICKS(HALL_FFT_PERIOD_SEC * 1000));
+    }
+    vTaskDelete(NULL);
+}
+
+#if CONFIG_HALL_FFT_BENCHMARK
+static void fft_benchmark(){
+    for (int n = 64; n <= HALL_FFT_BENCH_MAX_SIZE; n *= 2){
+        size_t free_before = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+        // Tabla de coeficientes de la FFT y buffers de entrada, datos complejos y ventana
+        if (dsps_fft2r_init_fc32(NULL, n) != ESP_OK){
+            ESP_LOGW(TAG, "FFT of %d points doesn't fit", n);
+            break;
+        }
+        float * input = malloc(n * sizeof(float));
+        float * data = malloc(2 * n * sizeof(float));
+        float * win = malloc(n * sizeof(float));
+        if (input == NULL || data == NULL || win == NULL){
+            free(input); free(data); free(win);
+            dsps_fft2r_deinit_fc32();
+            ESP_LOGW(TAG, "FFT of %d points doesn't fit", n);
+            break;
+        }
+        size_t bytes = free_before - heap_caps_get_free_size(MALLOC_CAP_8BIT);
+        dsps_wind_hann_f32(win, n);
+        // Tono de prueba en el bin n/8
+        for (int i = 0; i < n; i++) input[i] = 100 * sinf(2 * M_PI * i / 8);
+        float magnitude;
+        uint32_t start = esp_cpu_get_ccount();
+        int64_t start_us = esp_timer_get_time();
+        spectrum_peak(input, data, win, n, &magnitude);
+        int64_t elapsed_us = esp_timer_get_time() - start_us;
+        uint32_t cycles = esp_cpu_get_ccount() - start;
+        ESP_LOGI(TAG, "FFT %4d points: %lld us, %u cycles (%u/sample), %u bytes", n, elapsed_us, cycles, cycles / n, bytes);
+        free(input); free(data); free(win);
+        dsps_fft2r_deinit_fc32();
+    }
+}
+#endif
+
+void hall_fft_start(){
+#if CONFIG_HALL_FFT_BENCHMARK
+    fft_benchmark();
+#endif
+    // Tabla de coeficientes de la FFT del tamaño de captura y ventana de Hann
+    ESP_ERROR_CHECK(dsps_fft2r_init_fc32(NULL, HALL_FFT_SIZE));
+    dsps_wind_hann_f32(window, HALL_FFT_SIZE);
+    /* La captura se mide contra un cuarto del periodo de muestreo pero se queda en la tarea de los esp_timer:
+    en la tarea de trabajo los instantes de muestreo tendrían más jitter y el espectro se ensuciaría. Los avisos
+    de presupuesto indican que la frecuencia de captura es demasiado alta para el resto de timers.*/
+    const struct budget_timer_args timer_args = {
+        .callback = &capture_timer_callback,
+        .name = "Hall capture",
+        .budget_us = 1000000 / HALL_FFT_RATE_HZ / 4,
+        .mode = BUDGET_TIMER_INLINE
+    };
+    ESP_ERROR_CHECK(budget_timer_create(&timer_args, &capture_timer));
+    // Prioridad y núcleo de la tabla de tareas
+    struct task_plan_entry plan = task_plan_get(TASK_PLAN_HALL_FFT);
+#if CONFIG_STATIC_ALLOCATION
+    fft_task_handle = xTaskCreateStaticPinnedToCore(fft_task, "Hall FFT task", HALL_FFT_TASK_STACK_SIZE, NULL, plan.priority,
+                                                    fft_task_stack, &fft_task_buffer, plan.core);
+#else
+    xTaskCreatePinnedToCore(fft_task, "Hall FFT task", HALL_FFT_TASK_STACK_SIZE, NULL, plan.priority, &fft_task_handle, plan.core);
+#endif
+}
@@ -1,6 +1,7 @@
 #include <esp_log.h>
 #include <driver/i2c.h>
 #include "crc.h"
+#include "dispatcher.h"
 #include "si7021.h"
 
 // Número de controlador I2C que utilizaremos
@@ -23,14 +24,19 @@
 #define TIMEOUT_I2C 800000
 // Polinomio para la suma de comprobación del sensor (x^8 + x^5 + x^4 + 1)
 #define POLYNOMIAL_CRC 0x131
-
-// Definimos la base de eventos para este sensot
-ESP_EVENT_DEFINE_BASE(SI7021_EVENT);
+// Histéresis de los umbrales de grado en centésimas de grado
+#define SI7021_HYSTERESIS_CDEG CONFIG_SI7021_HYSTERESIS_CDEG
 
 // Etiqueta pa los mensajes de logging
 static const char* TAG  = "SI7021 sensor";
 // Variable para almacenar la temperatura de rerencia con la que comparar las lecturas de temperatura
 static float ref_temp;
+// Umbrales de un grado respecto a la temperatura de referencia, con histéresis para no oscilar en un umbral
+static struct dispatcher_threshold degree_threshold = {
+    .step = 1.0f,
+    .hysteresis = SI7021_HYSTERESIS_CDEG / 100.0f,
+    .level = 0
+};
 
 // Función que checkea la variación de temperatura respecto a la inicial
 static void check_degree_diff(float temp);
@@ -59,17 +65,6 @@ void si7021_init(){
     ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_set_timeout(I2C_MASTER_NUM,TIMEOUT_I2C));
     // Instalamos el controlador I2C
     ESP_ERROR_CHECK(i2c_driver_install(i2c_master_port, conf.mode, I2C_MASTER_RX_BUF_DISABLE, I2C_MASTER_TX_BUF_DISABLE, 0));
-
-    // Argumentos para el bucle de eventos asociado a este sensor
-    esp_event_loop_args_t event_loop_args = {
-        .queue_size = 5,
-        .task_name = "si7021_loop_task", // task will be created
-        .task_priority = uxTaskPriorityGet(NULL),
-        .task_stack_size = 2048,
-        .task_core_id = tskNO_AFFINITY
-    };
-    // Configuramos el bucle de eventos con dichos argumentos
-    ESP_ERROR_CHECK(esp_event_loop_create(&event_loop_args, &si7021_event_loop));
     // Fijamos la temperatura de referencia con una primera medición
     ref_temp = si7021_get_temp(true);
     // Informamos de la temperatura de referencia obtenida
@@ -116,24 +111,8 @@ float si7021_get_temp(bool use_checksum){
 }
 
 static void check_degree_diff(float temp){
-    // Variable para saber cuál es la variación entera en grados actual (inicialmente 0)
-    static int last_int_degrees_diff = 0;
-    // Calculamos la diferencia entera entre la temperatura recibida por parámetro y la temperatura inicial
-    int diff = (int) (temp - ref_temp);
-    // Tantas veces como grados enteros extra haya entre la última diferencia y la diferencia actual
-    for (int i = last_int_degrees_diff; i < diff; i++){
-        /* Emitimos un evento de aumento (por ejemplo, si antes había aumentado 2ºC enteros respecto a la inicial y con la 
-        última medición comprobamos que estamos en un aumento de 4ºC respecto a la inicial emitimos 2 eventos porque el bucle
-        da 2 vueltas)*/
-        ESP_ERROR_CHECK(esp_event_post_to(si7021_event_loop, SI7021_EVENT, SI7021_EVENT_ONE_DEGREE_UP, NULL, 0, pdMS_TO_TICKS(200)));
-    }
-     // Tantas veces como grados enteros extra haya entre la última diferencia y la diferencia actual
-    for (int i = diff; i < last_int_degrees_diff; i++){
-        /* Emitimos un evento de descenso (por ejemplo, si antes había aumentado 2ºC enteros respecto a la inicial y con la 
-        última medición comprobamos que estamos en un aumento de -1ºC respecto a la inicial emitimos 3 eventos porque el bucle
-        da 3 vueltas)*/
-        ESP_ERROR_CHECK(esp_event_post_to(si7021_event_loop, SI7021_EVENT, SI7021_EVENT_ONE_DEGREE_DOWN, NULL, 0, pdMS_TO_TICKS(200)));
-    }
-    // Colocamos como diferencia actual como última para la siguiente llamada
-    last_int_degrees_diff = diff;
-}
\ No newline at end of file
+    /* Un solo evento con el salto y los grados enteros de diferencia respecto a la temperatura inicial, aunque
+    se crucen varios grados de golpe. El evento va directo a la cola del consumidor sin esperar: esta función
+    la llama la propia tarea de la FSM, que no podría vaciar su cola mientras espera.*/
+    dispatcher_threshold_update(&degree_threshold, temp - ref_temp, DISPATCHER_SOURCE_SI7021, SI7021_EVENT_DEGREE_CHANGED);
+}
@@ -1,14 +1,10 @@
 #ifndef SI7021_H
 #define SI7021_H
-#include <esp_event.h>
-// Declaramos la base de eventos del sensor
-ESP_EVENT_DECLARE_BASE(SI7021_EVENT);
-// Event loop para los eventos del sensor
-esp_event_loop_handle_t si7021_event_loop;
-// Enumerado con los posibles identificadores de eventos del sensor
+#include <stdbool.h>
+/* Enumerado con los posibles identificadores de eventos del sensor (se emiten con el origen DISPATCHER_SOURCE_SI7021).
+SI7021_EVENT_DEGREE_CHANGED lleva DISPATCHER_LEVEL_DATA(grados enteros respecto a la referencia, salto en grados)*/
 enum {
-    SI7021_EVENT_ONE_DEGREE_UP,
-    SI7021_EVENT_ONE_DEGREE_DOWN
+    SI7021_EVENT_DEGREE_CHANGED
 };
 // Función para inicializar el sensor
 void si7021_init();
@@ -0,0 +1,27 @@
+#ifndef TASK_PLAN_H
+#define TASK_PLAN_H
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+/* Tareas de la aplicación. La prioridad y el núcleo de cada una salen de una única tabla configurable
+(menuconfig): la lógica de la FSM en la APP CPU y el trabajo de fondo (FFT y cuerpos de timers desviados)
+en la PRO CPU, junto a la tarea de los esp_timer.*/
+enum task_plan_id {
+    // Lógica de la FSM
+    TASK_PLAN_FSM,
+    // Detección de rotación por FFT del sensor hall
+    TASK_PLAN_HALL_FFT,
+    // Tarea de trabajo de los budget timers
+    TASK_PLAN_BUDGET_WORKER,
+    TASK_PLAN_NUM
+};
+
+// Prioridad y núcleo de una tarea (tskNO_AFFINITY si puede ejecutarse en cualquiera)
+struct task_plan_entry {
+    UBaseType_t priority;
+    BaseType_t core;
+};
+
+// Devuelve la prioridad y el núcleo de una tarea
+struct task_plan_entry task_plan_get(enum task_plan_id id);
+#endif
@@ -1,6 +1,11 @@
 #include "FSM.h"
+#include "dispatcher.h"
 
 void app_main(void){
+#if CONFIG_DISPATCHER_BENCHMARK
+    // Comparamos la latencia de los eventos por el dispatcher y por un bucle de esp_event antes de arrancar
+    dispatcher_benchmark();
+#endif
     // Inicializamos la máquina de estados que controla la aplicación y la arrancamos
     FSM_init_and_start();
 }
\ No newline at end of file
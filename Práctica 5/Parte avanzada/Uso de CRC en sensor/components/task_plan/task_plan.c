@@ -0,0 +1,20 @@
+#include "task_plan.h"
+
+// Núcleo de la tabla (-1 en menuconfig) para una tarea que puede ejecutarse en cualquiera
+#define TASK_PLAN_ANY_CORE -1
+
+// Tabla de prioridades y núcleos, en el orden de enum task_plan_id
+static const int plan[TASK_PLAN_NUM][2] = {
+    [TASK_PLAN_SAMPLING] = {CONFIG_TASK_PLAN_SAMPLING_PRIORITY, CONFIG_TASK_PLAN_SAMPLING_CORE},
+};
+
+
+struct task_plan_entry task_plan_get(enum task_plan_id id){
+    struct task_plan_entry entry = {
+        .priority = plan[id][0],
+        .core = plan[id][1]
+    };
+    // Con un solo núcleo (o sin núcleo fijo) la tarea puede ejecutarse en cualquiera
+    if (entry.core == TASK_PLAN_ANY_CORE || entry.core >= portNUM_PROCESSORS) entry.core = tskNO_AFFINITY;
+    return entry;
+}
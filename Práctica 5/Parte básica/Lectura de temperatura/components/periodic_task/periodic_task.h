@@ -0,0 +1,46 @@
+#ifndef PERIODIC_TASK_H
+#define PERIODIC_TASK_H
+#include <stdint.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Qué hacer cuando una ejecución se alarga más allá del siguiente instante previsto
+enum periodic_task_policy {
+    // Se saltan los instantes perdidos y se sigue en el siguiente instante futuro del periodo
+    PERIODIC_TASK_SKIP,
+    // Se ejecuta una vez por cada instante perdido, seguidas, hasta recuperar el ritmo
+    PERIODIC_TASK_CATCH_UP
+};
+
+// Estadísticas de retraso de una tarea periódica
+struct periodic_task_stats {
+    // Ejecuciones e instantes perdidos (saltados o ejecutados cuando ya había pasado el siguiente)
+    uint32_t runs;
+    uint32_t missed;
+    // Retraso del comienzo de cada ejecución respecto a su instante previsto (suma y máximo)
+    int64_t total_lateness_us;
+    int64_t max_lateness_us;
+};
+
+// Función que se ejecuta periódicamente
+typedef void (* periodic_task_fn)(void * arg);
+// Tarea periódica (opaca)
+struct periodic_task;
+
+/* Crea una tarea que ejecuta "func" cada "period_ms" con instantes absolutos (vTaskDelayUntil): el tiempo
+que tarda cada ejecución no se acumula como deriva. La primera ejecución es un periodo después de crearla.
+La tarea se fija al núcleo "core_id" (tskNO_AFFINITY para cualquiera). Devuelve NULL si no se puede crear.*/
+struct periodic_task * periodic_task_create(const char * name, periodic_task_fn func, void * arg, uint32_t period_ms,
+                                            enum periodic_task_policy policy, uint32_t stack_size, UBaseType_t priority,
+                                            BaseType_t core_id);
+// Para la tarea y libera sus recursos
+void periodic_task_delete(struct periodic_task * task);
+// Devuelve el handle de FreeRTOS de la tarea (para vigilar su pila sin buscarla por nombre)
+TaskHandle_t periodic_task_get_handle(struct periodic_task * task);
+// Copia las estadísticas de la tarea
+void periodic_task_get_stats(struct periodic_task * task, struct periodic_task_stats * stats);
+// Pone a cero las estadísticas de la tarea
+void periodic_task_reset_stats(struct periodic_task * task);
+// Muestra las estadísticas de la tarea por el puerto serie
+void periodic_task_show_stats(struct periodic_task * task);
+#endif
@@ -1,5 +1,17 @@
 #ifndef BUTTON_H
 #define BUTTON_H
-// Método para la configuración del botón (recibe la función a ejecutar cuando se pulsa)
-void config_button(void(* func_button)());
-#endif
\ No newline at end of file
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+// Eventos del botón una vez eliminados los rebotes
+enum button_event {
+    BUTTON_PRESS,
+    BUTTON_RELEASE,
+    // Se emite una vez si el botón sigue pulsado tras CONFIG_BUTTON_LONG_PRESS_MS
+    BUTTON_LONG_PRESS
+};
+/* Método para la configuración del botón (recibe las funciones a ejecutar cuando se pulsa y cuando se
+mantiene pulsado; se ejecutan en la tarea del botón, nunca en la ISR, y pueden ser NULL)*/
+void config_button(void(* func_press)(), void(* func_long_press)());
+// Devuelve la tarea del botón (NULL si aún no se ha configurado)
+TaskHandle_t button_get_task();
+#endif
@@ -0,0 +1,336 @@
+#include <string.h>
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_console.h>
+#include <nvs.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include "periodic_task.h"
+#include "diagnostics.h"
+
+// Periodo de muestreo y muestras entre informes por el puerto serie (0 para no mostrarlos)
+#define DIAGNOSTICS_PERIOD_MS (CONFIG_DIAGNOSTICS_PERIOD_SEC * 1000)
+#define DIAGNOSTICS_REPORT_SAMPLES CONFIG_DIAGNOSTICS_REPORT_SAMPLES
+// Holgura sobre el uso máximo de pila a partir de la cual una tarea está sobredimensionada (%)
+#define DIAGNOSTICS_OVERPROVISION_PCT CONFIG_DIAGNOSTICS_OVERPROVISION_PCT
+// Pila de la tarea de muestreo
+#define DIAGNOSTICS_TASK_STACK_SIZE CONFIG_DIAGNOSTICS_TASK_STACK_SIZE
+// Número máximo de tareas vigiladas y longitud máxima de sus nombres (con el terminador)
+#define DIAGNOSTICS_MAX_TASKS 16
+#define NAME_LEN 16
+// Granularidad del tamaño de pila recomendado
+#define STACK_ROUND_BYTES 256
+// Margen de pila aún sin medir
+#define NOT_SAMPLED UINT32_MAX
+// Espacio de nombres y clave de la NVS con el resumen
+#define DIAGNOSTICS_NAMESPACE "diag"
+#define DIAGNOSTICS_KEY "summary"
+
+static const char* TAG = "Diagnostics";
+
+// Tarea vigilada
+struct watched_task {
+    char name[NAME_LEN];
+    // NULL si la tarea ha terminado o solo se conoce por el resumen de arranques anteriores
+    TaskHandle_t handle;
+    uint32_t stack_size;
+    // Menor margen de pila visto, en bytes (NOT_SAMPLED si aún no se ha medido)
+    uint32_t min_free;
+};
+
+// Región de heap (memoria con unas capacidades) y sus medidas en bytes (todo 0 si la región no existe)
+struct heap_region {
+    const char * name;
+    uint32_t caps;
+    uint32_t total;
+    uint32_t free;
+    uint32_t min_free;
+    uint32_t largest;
+    uint32_t min_largest;
+};
+
+static struct heap_region regions[] = {
+    { .name = "internal", .caps = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT },
+    { .name = "dma", .caps = MALLOC_CAP_DMA },
+    { .name = "spiram", .caps = MALLOC_CAP_SPIRAM }
+};
+#define NUM_REGIONS (sizeof(regions) / sizeof(regions[0]))
+
+/* Resumen compacto que se guarda en NVS: los mínimos de las regiones de heap en este arranque y, por tarea,
+el menor margen de pila visto desde que tiene su tamaño actual (20 bytes por tarea)*/
+struct nvs_task {
+    char name[NAME_LEN];
+    uint16_t stack_size;
+    uint16_t min_free;
+};
+struct nvs_region {
+    uint32_t min_free;
+    uint32_t min_largest;
+};
+struct nvs_summary {
+    struct nvs_region regions[NUM_REGIONS];
+    uint32_t num_tasks;
+    struct nvs_task tasks[DIAGNOSTICS_MAX_TASKS];
+};
+
+// Tareas vigiladas, protegidas por "lock" (un mutex: la medida de una pila no es instantánea)
+static struct watched_task tasks[DIAGNOSTICS_MAX_TASKS];
+static int num_tasks = 0;
+static SemaphoreHandle_t lock;
+// Algún mínimo ha empeorado desde que se guardó el resumen
+static bool dirty = false;
+// Ya se ha avisado de que la tabla de tareas está llena
+static bool full_logged = false;
+static struct periodic_task * sampling_task;
+
+// Busca la entrada libre de una tarea con ese nombre o añade una (NULL si no caben más). Con "lock" tomado
+static struct watched_task * get_entry(const char * name, uint32_t stack_size);
+// Empieza a vigilar una tarea. Con "lock" tomado
+static void watch_locked(TaskHandle_t task, uint32_t stack_size);
+// Mide el margen de pila de una tarea vigilada y actualiza su mínimo. Con "lock" tomado
+static void measure_task(struct watched_task * task);
+// Mide todas las pilas y regiones de heap
+static void sample();
+// Guarda el resumen en NVS
+static void save_summary();
+// Carga el resumen de NVS, lo muestra y continúa acumulando sus mínimos. Devuelve false si no hay
+static bool load_summary();
+// Muestra el estado de una tarea (y si está sobredimensionada)
+static void show_task(const char * name, uint32_t stack_size, uint32_t min_free);
+// Cuerpo de la tarea de muestreo
+static void sampling_body(void * args);
+// Comando de consola "diag"
+static int do_diag(int argc, char **argv);
+
+
+static struct watched_task * get_entry(const char * name, uint32_t stack_size){
+    for (int i = 0; i < num_tasks; i++) {
+        if (tasks[i].handle == NULL && strncmp(tasks[i].name, name, NAME_LEN - 1) == 0) {
+            // Con otro tamaño de pila los mínimos anteriores ya no sirven
+            if (tasks[i].stack_size != stack_size) tasks[i].min_free = NOT_SAMPLED;
+            tasks[i].stack_size = stack_size;
+            return &tasks[i];
+        }
+    }
+    if (num_tasks == DIAGNOSTICS_MAX_TASKS) {
+        if (!full_logged) ESP_LOGW(TAG, "Too many tasks, %s is not watched", name);
+        full_logged = true;
+        return NULL;
+    }
+    struct watched_task * task = &tasks[num_tasks++];
+    strlcpy(task->name, name, NAME_LEN);
+    task->stack_size = stack_size;
+    task->min_free = NOT_SAMPLED;
+    return task;
+}
+
+static void watch_locked(TaskHandle_t task, uint32_t stack_size){
+    if (task == NULL) return;
+    struct watched_task * entry = get_entry(pcTaskGetName(task), stack_size);
+    if (entry != NULL) entry->handle = task;
+}
+
+static void measure_task(struct watched_task * task){
+    uint32_t free_bytes = uxTaskGetStackHighWaterMark(task->handle);
+    if (free_bytes < task->min_free) {
+        task->min_free = free_bytes;
+        dirty = true;
+    }
+}
+
+static void sample(){
+    xSemaphoreTake(lock, portMAX_DELAY);
+    for (int i = 0; i < num_tasks; i++) {
+        if (tasks[i].handle != NULL) measure_task(&tasks[i]);
+    }
+    for (int i = 0; i < NUM_REGIONS; i++) {
+        struct heap_region * region = &regions[i];
+        region->total = heap_caps_get_total_size(region->caps);
+        if (region->total == 0) continue;
+        region->free = heap_caps_get_free_size(region->caps);
+        region->largest = heap_caps_get_largest_free_block(region->caps);
+        // El mínimo de memoria libre lo lleva el propio heap; el del mayor bloque solo lo vemos al muestrear
+        uint32_t min_free = heap_caps_get_minimum_free_size(region->caps);
+        if (region->min_largest == 0 || region->largest < region->min_largest) {
+            region->min_largest = region->largest;
+            dirty = true;
+        }
+        if (min_free != region->min_free) {
+            region->min_free = min_free;
+            dirty = true;
+        }
+    }
+    xSemaphoreGive(lock);
+}
+
+static void save_summary(){
+    struct nvs_summary summary = {0};
+    xSemaphoreTake(lock, portMAX_DELAY);
+    for (int i = 0; i < NUM_REGIONS; i++) {
+        summary.regions[i].min_free = regions[i].min_free;
+        summary.regions[i].min_largest = regions[i].min_largest;
+    }
+    for (int i = 0; i < num_tasks; i++) {
+        if (tasks[i].min_free == NOT_SAMPLED) continue;
+        struct nvs_task * task = &summary.tasks[summary.num_tasks++];
+        memcpy(task->name, tasks[i].name, NAME_LEN);
+        task->stack_size = tasks[i].stack_size;
+        task->min_free = tasks[i].min_free;
+    }
+    dirty = false;
+    xSemaphoreGive(lock);
+    // Solo se guardan las tareas medidas
+    size_t len = sizeof(summary) - sizeof(summary.tasks) + summary.num_tasks * sizeof(struct nvs_task);
+    nvs_handle_t nvs_handle;
+    if (nvs_open(DIAGNOSTICS_NAMESPACE, NVS_READWRITE, &nvs_handle) != ESP_OK) return;
+    ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_set_blob(nvs_handle, DIAGNOSTICS_KEY, &summary, len));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_commit(nvs_handle));
+    nvs_close(nvs_handle);
+}
+
+static bool load_summary(){
+    struct nvs_summary summary;
+    size_t len = sizeof(summary);
+    nvs_handle_t nvs_handle;
+    if (nvs_open(DIAGNOSTICS_NAMESPACE, NVS_READONLY, &nvs_handle) != ESP_OK) return false;
+    esp_err_t err = nvs_get_blob(nvs_handle, DIAGNOSTICS_KEY, &summary, &len);
+    nvs_close(nvs_handle);
+    if (err != ESP_OK || len < sizeof(summary) - sizeof(summary.tasks) || summary.num_tasks > DIAGNOSTICS_MAX_TASKS) return false;
+    ESP_LOGI(TAG, "Summary saved by the previous boot:");
+    for (int i = 0; i < NUM_REGIONS; i++) {
+        if (summary.regions[i].min_free == 0) continue;
+        ESP_LOGI(TAG, "  heap %-8s min free %6u, min largest block %6u", regions[i].name,
+                 summary.regions[i].min_free, summary.regions[i].min_largest);
+    }
+    xSemaphoreTake(lock, portMAX_DELAY);
+    for (int i = 0; i < summary.num_tasks; i++) {
+        struct nvs_task * saved = &summary.tasks[i];
+        saved->name[NAME_LEN - 1] = '\0';
+        show_task(saved->name, saved->stack_size, saved->min_free);
+        /* Los mínimos de la misma tarea con la misma pila se siguen acumulando en este arranque. Si la pila
+        ha cambiado se descartan; si la tarea aún no existe, su entrada espera a que se cree.*/
+        struct watched_task * task = NULL;
+        for (int j = 0; j < num_tasks && task == NULL; j++) {
+            if (strcmp(tasks[j].name, saved->name) == 0) task = &tasks[j];
+        }
+        if (task == NULL) task = get_entry(saved->name, saved->stack_size);
+        if (task != NULL && task->stack_size == saved->stack_size && saved->min_free < task->min_free) {
+            task->min_free = saved->min_free;
+        }
+    }
+    xSemaphoreGive(lock);
+    return true;
+}
+
+static void show_task(const char * name, uint32_t stack_size, uint32_t min_free){
+    if (min_free == NOT_SAMPLED) {
+        ESP_LOGI(TAG, "  %-16s stack %5u, not sampled yet", name, stack_size);
+        return;
+    }
+    uint32_t used = stack_size > min_free ? stack_size - min_free : 0;
+    // Tamaño con la holgura configurada sobre el máximo usado: si la pila es mayor, sobra memoria
+    uint32_t needed = (used * (100 + DIAGNOSTICS_OVERPROVISION_PCT) / 100 + STACK_ROUND_BYTES - 1) / STACK_ROUND_BYTES * STACK_ROUND_BYTES;
+    if (stack_size > needed) {
+        ESP_LOGW(TAG, "  %-16s stack %5u, max used %5u, min free %5u: over-provisioned, %u would do", name,
+                 stack_size, used, min_free, needed);
+    }
+    else {
+        ESP_LOGI(TAG, "  %-16s stack %5u, max used %5u, min free %5u", name, stack_size, used, min_free);
+    }
+}
+
+static void sampling_body(void * args){
+    static unsigned int samples = 0;
+    samples++;
+    sample();
+    // Los mínimos solo bajan, así que la NVS se escribe pocas veces
+    if (dirty) save_summary();
+    if (DIAGNOSTICS_REPORT_SAMPLES > 0 && samples % DIAGNOSTICS_REPORT_SAMPLES == 0) diagnostics_show();
+}
+
+void diagnostics_init(uint32_t main_stack_size){
+    static StaticSemaphore_t lock_buffer;
+    lock = xSemaphoreCreateMutexStatic(&lock_buffer);
+    diagnostics_watch_task(xTaskGetCurrentTaskHandle(), main_stack_size);
+}
+
+BaseType_t diagnostics_create_task(TaskFunction_t func, const char * name, uint32_t stack_size, void * arg,
+                                   UBaseType_t priority, TaskHandle_t * handle, BaseType_t core_id){
+    TaskHandle_t task = NULL;
+    if (handle == NULL) handle = &task;
+    if (lock == NULL) return xTaskCreatePinnedToCore(func, name, stack_size, arg, priority, handle, core_id);
+    /* Con el mutex tomado la tarea no puede llegar a diagnostics_task_exit antes de estar registrada,
+    y quien crea la tarea no puede ver su handle liberado*/
+    xSemaphoreTake(lock, portMAX_DELAY);
+    BaseType_t ret = xTaskCreatePinnedToCore(func, name, stack_size, arg, priority, handle, core_id);
+    if (ret == pdPASS) watch_locked(*handle, stack_size);
+    xSemaphoreGive(lock);
+    return ret;
+}
+
+void diagnostics_watch_task(TaskHandle_t task, uint32_t stack_size){
+    if (lock == NULL) return;
+    xSemaphoreTake(lock, portMAX_DELAY);
+    watch_locked(task, stack_size);
+    xSemaphoreGive(lock);
+}
+
+void diagnostics_task_exit(){
+    if (lock == NULL) return;
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    xSemaphoreTake(lock, portMAX_DELAY);
+    for (int i = 0; i < num_tasks; i++) {
+        if (tasks[i].handle != self) continue;
+        measure_task(&tasks[i]);
+        tasks[i].handle = NULL;
+    }
+    xSemaphoreGive(lock);
+}
+
+void diagnostics_start(UBaseType_t priority, BaseType_t core_id){
+    if (lock == NULL) return;
+    // Tareas del sistema cuya pila se configura en menuconfig
+    diagnostics_watch_task(xTaskGetHandle("esp_timer"), CONFIG_ESP_TIMER_TASK_STACK_SIZE);
+    diagnostics_watch_task(xTaskGetHandle("sys_evt"), CONFIG_ESP_SYSTEM_EVENT_TASK_STACK_SIZE);
+    diagnostics_watch_task(xTaskGetHandle("tiT"), CONFIG_LWIP_TCPIP_TASK_STACK_SIZE);
+    if (!load_summary()) ESP_LOGI(TAG, "No summary saved by a previous boot");
+    sampling_task = periodic_task_create("Diagnostics", sampling_body, NULL, DIAGNOSTICS_PERIOD_MS, PERIODIC_TASK_SKIP,
+                                         DIAGNOSTICS_TASK_STACK_SIZE, priority, core_id);
+    if (sampling_task == NULL) ESP_LOGE(TAG, "Could not start the diagnostics sampling");
+    // La propia tarea de muestreo también se vigila
+    else diagnostics_watch_task(periodic_task_get_handle(sampling_task), DIAGNOSTICS_TASK_STACK_SIZE);
+}
+
+void diagnostics_show(){
+    if (lock == NULL) return;
+    sample();
+    ESP_LOGI(TAG, "Stack usage (max used since the size was set):");
+    xSemaphoreTake(lock, portMAX_DELAY);
+    for (int i = 0; i < num_tasks; i++) show_task(tasks[i].name, tasks[i].stack_size, tasks[i].min_free);
+    for (int i = 0; i < NUM_REGIONS; i++) {
+        struct heap_region * region = &regions[i];
+        if (region->total == 0) continue;
+        ESP_LOGI(TAG, "  heap %-8s total %6u, free %6u (min %6u), largest block %6u (min %6u)", region->name,
+                 region->total, region->free, region->min_free, region->largest, region->min_largest);
+    }
+    xSemaphoreGive(lock);
+}
+
+static int do_diag(int argc, char **argv){
+    diagnostics_show();
+    return 0;
+}
+
+void register_diagnostics(){
+    // Configuración del comando "diag" que vamos a registrar
+    const esp_console_cmd_t diag_cmd = {
+        .command = "diag",
+        .help = "Show stack high-water marks of the watched tasks and heap usage per region",
+        .hint = NULL,
+        .func = &do_diag,
+        .argtable = NULL
+    };
+    // Registramos el comando en la consola
+    ESP_ERROR_CHECK(esp_console_cmd_register(&diag_cmd));
+}
@@ -0,0 +1,29 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+#include <stdint.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+/* Diagnóstico de memoria para dimensionar pilas y heap. Se vigila el margen mínimo de pila (high-water mark)
+de cada tarea registrada y, por región de heap, la memoria libre mínima y el mayor bloque libre. Las tareas
+que dejan sin usar más de CONFIG_DIAGNOSTICS_OVERPROVISION_PCT de su pila se marcan como sobredimensionadas.*/
+
+// Prepara el módulo y vigila la tarea que llama (la principal). Debe llamarse antes de crear tareas vigiladas
+void diagnostics_init(uint32_t main_stack_size);
+/* Crea una tarea (mismos argumentos que xTaskCreatePinnedToCore) y empieza a vigilar su pila. El registro
+se hace antes de que la tarea pueda terminar, así que sirve también para tareas de corta duración.*/
+BaseType_t diagnostics_create_task(TaskFunction_t func, const char * name, uint32_t stack_size, void * arg,
+                                   UBaseType_t priority, TaskHandle_t * handle, BaseType_t core_id);
+// Empieza a vigilar la pila de una tarea ya creada con "stack_size" bytes de pila (NULL se ignora)
+void diagnostics_watch_task(TaskHandle_t task, uint32_t stack_size);
+/* Anota el margen de pila de la tarea que llama y deja de vigilarla. Las tareas vigiladas que terminan lo
+llaman justo antes de vTaskDelete(NULL); su entrada (por nombre) conserva el mínimo para la próxima vez.*/
+void diagnostics_task_exit();
+/* Muestra el resumen guardado en NVS (mínimos de arranques anteriores, que se siguen acumulando mientras no
+cambie el tamaño de pila) y arranca el muestreo periódico. Necesita la NVS inicializada.*/
+void diagnostics_start(UBaseType_t priority, BaseType_t core_id);
+// Toma una muestra y muestra por el puerto serie el uso de cada pila y de cada región de heap
+void diagnostics_show();
+// Registra el comando de consola "diag" que muestra el informe bajo demanda
+void register_diagnostics();
+#endif
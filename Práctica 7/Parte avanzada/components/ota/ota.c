@@ -8,23 +8,43 @@
 */
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "esp_system.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "esp_ota_ops.h"
 #include "esp_http_client.h"
-#include "esp_https_ota.h"
+#include "esp_partition.h"
 #include "string.h"
+#include "strings.h"
 #include "nvs.h"
 #include "nvs_flash.h"
+#include "esp_console.h"
 #include "protocol_examples_common.h"
 #include <sys/socket.h>
 #include "ota.h"
+#include "ota_package.h"
+#include "ota_writer.h"
+#include "task_plan.h"
+#include "diagnostics.h"
 #if CONFIG_EXAMPLE_CONNECT_WIFI
 #include "esp_wifi.h"
 #endif
 
 #define HASH_LEN 32
+// Espacio de nombres y clave de la NVS donde se guardan los hashes de las particiones
+#define SHA256_CACHE_NAMESPACE "ota_sha"
+#define SHA256_CACHE_KEY "digests"
+
+// Hashes de bootloader y firmware junto con la clave que identifica la imagen para la que se calcularon
+struct sha256_cache {
+    uint32_t partition_address;
+    uint32_t partition_size;
+    uint8_t elf_sha[HASH_LEN];
+    uint8_t bootloader_sha[HASH_LEN];
+    uint8_t firmware_sha[HASH_LEN];
+};
 
 #ifdef CONFIG_EXAMPLE_FIRMWARE_UPGRADE_BIND_IF
 /* The interface name value can refer to if_desc in esp_netif_defaults.h */
@@ -36,10 +56,79 @@ static const char *bind_interface_name = "sta";
 #endif
 
 static const char *TAG = "OTA";
+// Definimos la base de eventos de la actualización OTA
+ESP_EVENT_DEFINE_BASE(OTA_EVENT);
 extern const uint8_t server_cert_pem_start[] asm("_binary_ca_cert_pem_start");
 extern const uint8_t server_cert_pem_end[] asm("_binary_ca_cert_pem_end");
 
 #define OTA_URL_SIZE 256
+// Tamaño máximo de la cabecera ETag que guardamos para validar la reanudación
+#define OTA_ETAG_SIZE 64
+// Número máximo de reconexiones seguidas sin avanzar en la descarga antes de desistir
+#define OTA_MAX_RETRIES CONFIG_OTA_MAX_RETRIES
+// Espera entre una caída de la conexión y el siguiente intento
+#define OTA_RETRY_DELAY_MS CONFIG_OTA_RETRY_DELAY_MS
+// Cada cuántos bytes escritos en flash se guarda el progreso en NVS (siempre sectores enteros)
+#define OTA_PROGRESS_SAVE_BYTES (CONFIG_OTA_PROGRESS_SAVE_SECTORS * SPI_FLASH_SEC_SIZE)
+// Espacio de nombres y clave de la NVS donde se guarda el progreso de la descarga
+#define OTA_PROGRESS_NAMESPACE "ota_dl"
+#define OTA_PROGRESS_KEY "progress"
+// Clave de la NVS con el ETag de la última imagen instalada
+#define OTA_INSTALLED_KEY "installed"
+// Clave de la NVS con la última imagen revertida (autotest fallido o rollback), para no volver a descargarla
+#define OTA_REJECTED_KEY "rejected"
+#define OTA_VERSION_SIZE 32
+// Periodo de la comprobación automática de versión (0 desactivada)
+#define OTA_CHECK_PERIOD_SEC CONFIG_OTA_CHECK_PERIOD_SEC
+// Pila de la tarea de actualización en segundo plano (su prioridad y núcleo salen de la tabla de tareas)
+#define OTA_TASK_STACK_SIZE 6144
+// Límite de velocidad de descarga en KB/s (0 sin límite)
+#define OTA_MAX_KBPS CONFIG_OTA_MAX_KBPS
+// Cada cuánto (en tanto por ciento de la imagen) se emite un evento de progreso
+#define OTA_PROGRESS_EVENT_STEP 5
+
+/* Progreso de una descarga OTA. Se guarda en NVS para poder reanudar con una petición
+HTTP Range tras una caída de la conexión o un reinicio. Solo se reanuda si la URL, la partición
+destino, el tamaño de la imagen y su ETag coinciden con los de la descarga interrumpida.*/
+struct ota_progress {
+    char url[OTA_URL_SIZE];
+    char etag[OTA_ETAG_SIZE];
+    uint32_t partition_address;
+    uint32_t image_size;
+    // Siempre múltiplo del tamaño de sector (solo se cuenta lo ya escrito en flash)
+    uint32_t bytes_written;
+};
+
+// Imagen escrita por la última actualización y su ETag, para la comprobación de versión
+struct ota_installed {
+    uint32_t partition_address;
+    char etag[OTA_ETAG_SIZE];
+};
+
+// Imagen revertida tras instalarla: su ETag y su versión de aplicación
+struct ota_rejected {
+    char etag[OTA_ETAG_SIZE];
+    char version[OTA_VERSION_SIZE];
+};
+
+// Última cabecera ETag recibida del servidor (la rellena el manejador de eventos HTTP)
+static char last_etag[OTA_ETAG_SIZE];
+// Exclusión entre las transferencias que escriben la partición pasiva (descarga HTTP y recepción por UART)
+static SemaphoreHandle_t transfer_lock;
+/* Hay una tarea de actualización en segundo plano en curso. Se reserva (con ota_task_mux) antes de crear la
+tarea, así que el botón y la comprobación periódica no pueden lanzar dos a la vez*/
+static volatile bool ota_task_running = false;
+static portMUX_TYPE ota_task_mux = portMUX_INITIALIZER_UNLOCKED;
+// Petición de cancelación de la actualización en curso
+static volatile bool ota_cancel_requested = false;
+// Instante de inicio y bytes descargados en este intento, para limitar el ancho de banda
+static int64_t throttle_start;
+static uint32_t throttle_bytes;
+// Último porcentaje notificado con un evento de progreso
+static int last_progress_step;
+
+// Guarda en la caché de hashes los de una imagen recién descargada
+static void seed_sha256_cache(const esp_partition_t * partition, const uint8_t * elf_sha, const uint8_t * firmware_sha);
 
 static esp_err_t _http_event_handler(esp_http_client_event_t *evt)
 {
@@ -55,6 +144,10 @@ static esp_err_t _http_event_handler(esp_http_client_event_t *evt)
         break;
     case HTTP_EVENT_ON_HEADER:
         ESP_LOGD(TAG, "HTTP_EVENT_ON_HEADER, key=%s, value=%s", evt->header_key, evt->header_value);
+        // Nos quedamos con el ETag de la imagen para comprobar al reanudar que no ha cambiado
+        if (strcasecmp(evt->header_key, "ETag") == 0) {
+            strlcpy(last_etag, evt->header_value, sizeof(last_etag));
+        }
         break;
     case HTTP_EVENT_ON_DATA:
         ESP_LOGD(TAG, "HTTP_EVENT_ON_DATA, len=%d", evt->data_len);
@@ -69,6 +162,330 @@ static esp_err_t _http_event_handler(esp_http_client_event_t *evt)
     return ESP_OK;
 }
 
+bool ota_transfer_lock()
+{
+    return xSemaphoreTake(transfer_lock, 0) == pdTRUE;
+}
+
+void ota_transfer_unlock()
+{
+    xSemaphoreGive(transfer_lock);
+}
+
+static bool load_ota_progress(struct ota_progress * progress)
+{
+    nvs_handle_t nvs_handle;
+    if (nvs_open(OTA_PROGRESS_NAMESPACE, NVS_READONLY, &nvs_handle) != ESP_OK) return false;
+    size_t size = sizeof(struct ota_progress);
+    esp_err_t err = nvs_get_blob(nvs_handle, OTA_PROGRESS_KEY, progress, &size);
+    nvs_close(nvs_handle);
+    return err == ESP_OK && size == sizeof(struct ota_progress);
+}
+
+static void save_ota_progress(const struct ota_progress * progress)
+{
+    nvs_handle_t nvs_handle;
+    ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_open(OTA_PROGRESS_NAMESPACE, NVS_READWRITE, &nvs_handle));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_set_blob(nvs_handle, OTA_PROGRESS_KEY, progress, sizeof(struct ota_progress)));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_commit(nvs_handle));
+    nvs_close(nvs_handle);
+}
+
+void clear_ota_progress()
+{
+    nvs_handle_t nvs_handle;
+    if (nvs_open(OTA_PROGRESS_NAMESPACE, NVS_READWRITE, &nvs_handle) != ESP_OK) return;
+    nvs_erase_key(nvs_handle, OTA_PROGRESS_KEY);
+    ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_commit(nvs_handle));
+    nvs_close(nvs_handle);
+}
+
+// Descarta el progreso guardado: el siguiente intento pide la imagen desde el principio
+static void reset_ota_progress(struct ota_progress * progress)
+{
+    clear_ota_progress();
+    progress->bytes_written = 0;
+    progress->image_size = 0;
+    progress->etag[0] = '\0';
+}
+
+static void save_installed_etag(const esp_partition_t * partition, const char * etag)
+{
+    struct ota_installed installed = { .partition_address = partition->address };
+    strlcpy(installed.etag, etag, sizeof(installed.etag));
+    nvs_handle_t nvs_handle;
+    if (nvs_open(OTA_PROGRESS_NAMESPACE, NVS_READWRITE, &nvs_handle) != ESP_OK) return;
+    ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_set_blob(nvs_handle, OTA_INSTALLED_KEY, &installed, sizeof(installed)));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_commit(nvs_handle));
+    nvs_close(nvs_handle);
+}
+
+static bool load_installed_etag(struct ota_installed * installed)
+{
+    size_t len = sizeof(struct ota_installed);
+    nvs_handle_t nvs_handle;
+    if (nvs_open(OTA_PROGRESS_NAMESPACE, NVS_READONLY, &nvs_handle) != ESP_OK) return false;
+    esp_err_t err = nvs_get_blob(nvs_handle, OTA_INSTALLED_KEY, installed, &len);
+    nvs_close(nvs_handle);
+    return err == ESP_OK && len == sizeof(struct ota_installed);
+}
+
+void ota_get_installed_etag(char * etag, size_t size)
+{
+    etag[0] = '\0';
+    struct ota_installed installed;
+    // Solo vale si la imagen en ejecución es la que se instaló (no tras un rollback)
+    if (load_installed_etag(&installed) && installed.partition_address == esp_ota_get_running_partition()->address) {
+        strlcpy(etag, installed.etag, size);
+    }
+}
+
+bool ota_get_rejected_image(char * etag, size_t etag_size, char * version, size_t version_size)
+{
+    struct ota_rejected rejected;
+    size_t len = sizeof(rejected);
+    nvs_handle_t nvs_handle;
+    if (nvs_open(OTA_PROGRESS_NAMESPACE, NVS_READONLY, &nvs_handle) != ESP_OK) return false;
+    esp_err_t err = nvs_get_blob(nvs_handle, OTA_REJECTED_KEY, &rejected, &len);
+    nvs_close(nvs_handle);
+    if (err != ESP_OK || len != sizeof(rejected)) return false;
+    strlcpy(etag, rejected.etag, etag_size);
+    strlcpy(version, rejected.version, version_size);
+    return true;
+}
+
+void ota_clear_rejected_image()
+{
+    nvs_handle_t nvs_handle;
+    if (nvs_open(OTA_PROGRESS_NAMESPACE, NVS_READWRITE, &nvs_handle) != ESP_OK) return;
+    nvs_erase_key(nvs_handle, OTA_REJECTED_KEY);
+    ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_commit(nvs_handle));
+    nvs_close(nvs_handle);
+}
+
+/* Si la última imagen instalada no pasó la verificación o el bootloader la revirtió, anota en NVS su ETag
+y su versión para que la comprobación de versión no la vuelva a descargar (y a revertir) una y otra vez*/
+static void record_rejected_image()
+{
+    const esp_partition_t * invalid = esp_ota_get_last_invalid_partition();
+    struct ota_installed installed;
+    // Solo nos interesan las imágenes descargadas por la actualización HTTP (las que tienen ETag anotado)
+    if (invalid == NULL || !load_installed_etag(&installed) || installed.partition_address != invalid->address) return;
+    struct ota_rejected rejected = { 0 };
+    strlcpy(rejected.etag, installed.etag, sizeof(rejected.etag));
+    esp_app_desc_t desc;
+    if (esp_ota_get_partition_description(invalid, &desc) == ESP_OK) {
+        strlcpy(rejected.version, desc.version, sizeof(rejected.version));
+    }
+    ESP_LOGW(TAG, "Image %s (version %s) was rolled back, it will not be downloaded again", rejected.etag, rejected.version);
+    nvs_handle_t nvs_handle;
+    if (nvs_open(OTA_PROGRESS_NAMESPACE, NVS_READWRITE, &nvs_handle) != ESP_OK) return;
+    ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_set_blob(nvs_handle, OTA_REJECTED_KEY, &rejected, sizeof(rejected)));
+    // El ETag pasa a la imagen rechazada: así se anota una sola vez aunque la partición siga marcada inválida
+    nvs_erase_key(nvs_handle, OTA_INSTALLED_KEY);
+    ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_commit(nvs_handle));
+    nvs_close(nvs_handle);
+}
+
+// Callback del escritor OTA: cada sector escrito en flash cuenta como progreso de la descarga
+static void on_sector_written(uint32_t bytes_written, void * arg)
+{
+    struct ota_progress * progress = (struct ota_progress *) arg;
+    progress->bytes_written = bytes_written;
+    // Guardamos el progreso cada cierto número de bytes para no desgastar la NVS con cada sector
+    if (bytes_written % OTA_PROGRESS_SAVE_BYTES == 0) save_ota_progress(progress);
+}
+
+/* Se llama tras cada lectura de la descarga: emite eventos de progreso y, si hay límite de ancho de banda,
+duerme la tarea lo necesario para no superarlo (dejando la CPU y la radio al resto de la aplicación).
+Devuelve false si se ha pedido cancelar la actualización.*/
+static bool after_read(int read, uint32_t done, uint32_t total)
+{
+    int step = (int) ((uint64_t) done * 100 / total / OTA_PROGRESS_EVENT_STEP);
+    if (step != last_progress_step) {
+        last_progress_step = step;
+        struct ota_progress_event event = { .bytes_done = done, .bytes_total = total };
+        // Sin bloquear: si la cola de eventos está llena se pierde esta notificación, no la descarga
+        esp_event_post(OTA_EVENT, OTA_EVENT_PROGRESS, &event, sizeof(event), 0);
+    }
+#if OTA_MAX_KBPS > 0
+    throttle_bytes += read;
+    int64_t expected_us = (int64_t) throttle_bytes * 1000000 / (OTA_MAX_KBPS * 1024);
+    int64_t elapsed_us = esp_timer_get_time() - throttle_start;
+    if (expected_us > elapsed_us) vTaskDelay(pdMS_TO_TICKS((expected_us - elapsed_us) / 1000));
+#endif
+    return !ota_cancel_requested;
+}
+
+/* Descarga un paquete OTA (imagen comprimida o parche delta) del que ya se han leído los primeros "filled" bytes
+en "buf". El paquete se descomprime sobre la marcha hacia la partición destino, así que no se puede reanudar
+a mitad: si se cae la conexión el siguiente intento empieza de nuevo.*/
+static esp_err_t ota_download_package(esp_http_client_handle_t client, const esp_partition_t * partition,
+                                      uint32_t package_size, uint8_t * buf, size_t filled)
+{
+    ota_package_handle_t package = ota_package_begin(partition, esp_ota_get_running_partition());
+    if (package == NULL) return ESP_ERR_NO_MEM;
+    uint32_t received = filled;
+    esp_err_t err = ota_package_write(package, buf, filled);
+    while (err == ESP_OK && received < package_size) {
+        int read = esp_http_client_read(client, (char *) buf, SPI_FLASH_SEC_SIZE);
+        if (read <= 0) {
+            ESP_LOGW(TAG, "Connection lost at %u/%u package bytes", received, package_size);
+            err = ESP_FAIL;
+            break;
+        }
+        received += read;
+        err = ota_package_write(package, buf, read);
+        if (err == ESP_OK && !after_read(read, received, package_size)) err = ESP_FAIL;
+    }
+    if (err != ESP_OK) {
+        ota_package_abort(package);
+        return err;
+    }
+    return ota_package_finish(package);
+}
+
+/* Realiza un intento de descarga desde el byte "progress->bytes_written" hasta el final de la imagen.
+Devuelve ESP_OK si la imagen queda completa en la partición, ESP_ERR_INVALID_SIZE si la imagen no cabe y
+cualquier otro error si se cae la conexión (el progreso queda actualizado para el siguiente intento).*/
+static esp_err_t ota_download_attempt(esp_http_client_config_t * config, const esp_partition_t * partition,
+                                      struct ota_progress * progress, struct ota_image_hash * hash)
+{
+    esp_http_client_handle_t client = esp_http_client_init(config);
+    if (client == NULL) return ESP_FAIL;
+    // Si ya tenemos parte de la imagen pedimos solo el resto
+    char range[32];
+    if (progress->bytes_written > 0) {
+        snprintf(range, sizeof(range), "bytes=%u-", progress->bytes_written);
+        esp_http_client_set_header(client, "Range", range);
+        // Con If-Range el servidor nos devuelve la imagen completa (200) si ha cambiado desde entonces
+        if (progress->etag[0] != '\0') esp_http_client_set_header(client, "If-Range", progress->etag);
+    }
+    last_etag[0] = '\0';
+    throttle_start = esp_timer_get_time();
+    throttle_bytes = 0;
+    esp_err_t err = esp_http_client_open(client, 0);
+    if (err != ESP_OK) {
+        esp_http_client_cleanup(client);
+        return err;
+    }
+    int content_length = esp_http_client_fetch_headers(client);
+    int status = esp_http_client_get_status_code(client);
+    if (status == 206 && progress->bytes_written > 0 && content_length > 0
+        && progress->bytes_written + content_length == progress->image_size) {
+        ESP_LOGI(TAG, "Resuming download at %u/%u bytes", progress->bytes_written, progress->image_size);
+    }
+    else if (status == 200 && content_length > 0) {
+        // El servidor envía la imagen completa (descarga nueva, Range ignorado o imagen cambiada)
+        if (progress->bytes_written > 0) {
+            ESP_LOGW(TAG, "Server sent the whole image, restarting download");
+            reset_ota_progress(progress);
+        }
+        progress->image_size = content_length;
+        strlcpy(progress->etag, last_etag, sizeof(progress->etag));
+        save_ota_progress(progress);
+    }
+    else {
+        ESP_LOGE(TAG, "Unexpected HTTP response (status %d, length %d)", status, content_length);
+        /* Un rango que el servidor no sirve como esperábamos (206 con otra longitud, 416...) no va a
+        funcionar en el siguiente intento: empezamos de nuevo desde el byte 0*/
+        if (progress->bytes_written > 0) {
+            ESP_LOGW(TAG, "Discarding saved progress, restarting download");
+            reset_ota_progress(progress);
+        }
+        esp_http_client_cleanup(client);
+        return ESP_FAIL;
+    }
+    if (progress->image_size > partition->size) {
+        ESP_LOGE(TAG, "Image of %u bytes does not fit in partition of %u bytes", progress->image_size, partition->size);
+        esp_http_client_cleanup(client);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    uint8_t * buf = NULL;
+    size_t filled = 0;
+    int64_t download_start;
+    if (progress->bytes_written == 0) {
+        // Al empezar una descarga desde cero comprobamos si es un paquete comprimido en lugar de una imagen
+        buf = malloc(SPI_FLASH_SEC_SIZE);
+        if (buf == NULL) {
+            ESP_LOGE(TAG, "No memory for the download buffer");
+            esp_http_client_close(client);
+            esp_http_client_cleanup(client);
+            return ESP_ERR_NO_MEM;
+        }
+        while (filled < sizeof(uint32_t)) {
+            int read = esp_http_client_read(client, (char *) buf + filled, SPI_FLASH_SEC_SIZE - filled);
+            if (read <= 0) break;
+            filled += read;
+        }
+        if (filled >= sizeof(uint32_t) && ota_package_detect(buf, filled)) {
+            // El progreso se queda a 0: un paquete interrumpido se vuelve a descargar entero
+            err = ota_download_package(client, partition, progress->image_size, buf, filled);
+            free(buf);
+            esp_http_client_close(client);
+            esp_http_client_cleanup(client);
+            return err;
+        }
+        // El hash calculado al escribir solo es válido si la imagen se escribe entera desde el principio
+        ota_image_hash_reset(hash, progress->image_size);
+    }
+    /* La descarga (esta tarea) y el borrado/escritura en flash (tarea del escritor) van en paralelo:
+    mientras se escribe un sector se descarga el siguiente en otro buffer.*/
+    ota_writer_handle_t writer = ota_writer_start(partition, progress->bytes_written, progress->image_size,
+                                                  hash, on_sector_written, progress);
+    if (writer == NULL) {
+        free(buf);
+        esp_http_client_close(client);
+        esp_http_client_cleanup(client);
+        return ESP_ERR_NO_MEM;
+    }
+    // Lo ya leído para detectar el formato va al primer buffer del escritor
+    uint8_t * sector = ota_writer_get_buffer(writer);
+    if (buf != NULL) {
+        memcpy(sector, buf, filled);
+        free(buf);
+    }
+    // Posición de la descarga (por delante de lo escrito en flash por los buffers en vuelo)
+    uint32_t downloaded = progress->bytes_written;
+    err = ESP_OK;
+    while (err == ESP_OK && downloaded + filled < progress->image_size) {
+        size_t pending = progress->image_size - downloaded;
+        size_t wanted = (pending < SPI_FLASH_SEC_SIZE ? pending : SPI_FLASH_SEC_SIZE) - filled;
+        download_start = esp_timer_get_time();
+        int read = esp_http_client_read(client, (char *) sector + filled, wanted);
+        ota_writer_add_download_time(writer, esp_timer_get_time() - download_start);
+        // Cualquier lectura vacía antes de completar la imagen es una caída de la conexión
+        if (read <= 0) {
+            ESP_LOGW(TAG, "Connection lost at %u/%u bytes", downloaded + filled, progress->image_size);
+            err = ESP_FAIL;
+            break;
+        }
+        filled += read;
+        if (!after_read(read, downloaded + filled, progress->image_size)) {
+            err = ESP_FAIL;
+            break;
+        }
+        if (filled == SPI_FLASH_SEC_SIZE) {
+            err = ota_writer_submit(writer, sector, filled);
+            downloaded += filled;
+            filled = 0;
+            if (err == ESP_OK) sector = ota_writer_get_buffer(writer);
+        }
+    }
+    // Último trozo de la imagen (menor que un sector)
+    if (err == ESP_OK && filled > 0 && downloaded + filled == progress->image_size) {
+        err = ota_writer_submit(writer, sector, filled);
+    }
+    // Esperamos a que se escriba lo pendiente (un error de flash tiene prioridad sobre el de red)
+    esp_err_t write_err = ota_writer_stop(writer);
+    if (write_err != ESP_OK) err = write_err;
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+    // Los bytes del sector incompleto se descartan; el progreso guardado apunta siempre a un sector entero
+    save_ota_progress(progress);
+    return err;
+}
+
 void ota_update(){
     ESP_LOGI(TAG, "Starting OTA example");
 #ifdef CONFIG_EXAMPLE_FIRMWARE_UPGRADE_BIND_IF
@@ -109,11 +526,158 @@ void ota_update(){
     config.skip_cert_common_name_check = true;
 #endif
 
-    esp_err_t ret = esp_https_ota(&config);
+    // La recepción por UART escribe en la misma partición: no puede haber las dos a la vez
+    if (!ota_transfer_lock()) {
+        ESP_LOGW(TAG, "Another firmware transfer is in progress");
+        return;
+    }
+    const esp_partition_t *update_partition = esp_ota_get_next_update_partition(NULL);
+    if (update_partition == NULL) {
+        ESP_LOGE(TAG, "No OTA partition available to write the new image");
+        ota_transfer_unlock();
+        return;
+    }
+    // Recuperamos el progreso de una descarga anterior si era de la misma imagen y hacia la misma partición
+    struct ota_progress * progress = calloc(1, sizeof(struct ota_progress));
+    if (progress == NULL) {
+        ESP_LOGE(TAG, "No memory for the download progress");
+        ota_transfer_unlock();
+        esp_err_t err = ESP_ERR_NO_MEM;
+        esp_event_post(OTA_EVENT, OTA_EVENT_FAILED, &err, sizeof(err), 0);
+        return;
+    }
+    if (!load_ota_progress(progress) || strcmp(progress->url, config.url) != 0
+        || progress->partition_address != update_partition->address) {
+        memset(progress, 0, sizeof(struct ota_progress));
+        strlcpy(progress->url, config.url, sizeof(progress->url));
+        progress->partition_address = update_partition->address;
+    }
+
+    // Hash de la imagen que calcula el escritor (se conserva entre reconexiones de esta actualización)
+    struct ota_image_hash * hash = calloc(1, sizeof(struct ota_image_hash));
+    if (hash == NULL) {
+        ESP_LOGE(TAG, "No memory for the image hash");
+        free(progress);
+        ota_transfer_unlock();
+        esp_err_t err = ESP_ERR_NO_MEM;
+        esp_event_post(OTA_EVENT, OTA_EVENT_FAILED, &err, sizeof(err), 0);
+        return;
+    }
+
+#if CONFIG_EXAMPLE_CONNECT_WIFI
+    /* Quitamos el ahorro de energía del Wi-Fi solo mientras dura la transferencia (para tener el mejor
+    rendimiento) y restauramos después el modo que hubiese.*/
+    wifi_ps_type_t ps_before = WIFI_PS_MIN_MODEM;
+    esp_wifi_get_ps(&ps_before);
+    esp_wifi_set_ps(WIFI_PS_NONE);
+#endif
+    ota_cancel_requested = false;
+    last_progress_step = -1;
+    esp_event_post(OTA_EVENT, OTA_EVENT_STARTED, NULL, 0, 0);
+
+    esp_err_t ret = ESP_FAIL;
+    int retries = 0;
+    while (retries <= OTA_MAX_RETRIES && !ota_cancel_requested) {
+        uint32_t written_before = progress->bytes_written;
+        ret = ota_download_attempt(&config, update_partition, progress, hash);
+        if (ret == ESP_OK || ret == ESP_ERR_INVALID_SIZE || ota_cancel_requested) break;
+        // Solo cuentan como reintentos los intentos que no han conseguido avanzar
+        if (progress->bytes_written > written_before) retries = 0;
+        else retries++;
+        vTaskDelay(pdMS_TO_TICKS(OTA_RETRY_DELAY_MS));
+    }
     if (ret == ESP_OK) {
+        // La imagen está completa: ya no hay nada que reanudar
+        clear_ota_progress();
+        uint8_t digest[HASH_LEN];
+        esp_err_t hash_err = ota_image_hash_check(hash, digest);
+        if (hash_err == ESP_ERR_INVALID_CRC) {
+            // El hash calculado al vuelo no coincide: no merece la pena ni intentar arrancar la imagen
+            ESP_LOGE(TAG, "SHA-256 of downloaded image does not match");
+            ret = hash_err;
+        }
+        else {
+            // Al fijar la partición de arranque se verifica la imagen completa escrita en flash
+            int64_t verify_start = esp_timer_get_time();
+            ret = esp_ota_set_boot_partition(update_partition);
+            ESP_LOGI(TAG, "verify %lld ms", (esp_timer_get_time() - verify_start) / 1000);
+            // Con el hash ya calculado evitamos recorrer la partición nueva en su primer arranque
+            if (ret == ESP_OK && hash_err == ESP_OK) seed_sha256_cache(update_partition, hash->elf_sha, digest);
+            // Con el ETag la próxima comprobación de versión sabe que ya tenemos esta imagen
+            if (ret == ESP_OK) save_installed_etag(update_partition, progress->etag);
+        }
+    }
+    else {
+        mbedtls_sha256_free(&hash->ctx);
+    }
+    free(hash);
+    free(progress);
+    ota_transfer_unlock();
+#if CONFIG_EXAMPLE_CONNECT_WIFI
+    esp_wifi_set_ps(ps_before);
+#endif
+    if (ret == ESP_OK) {
+        esp_event_post(OTA_EVENT, OTA_EVENT_FINISHED, NULL, 0, 0);
+        // Dejamos un momento para que los manejadores atiendan el evento antes de reiniciar
+        vTaskDelay(pdMS_TO_TICKS(100));
         esp_restart();
+    } else if (ota_cancel_requested) {
+        // El progreso queda guardado: la próxima actualización continúa donde se canceló esta
+        ESP_LOGI(TAG, "Firmware upgrade cancelled");
+        esp_event_post(OTA_EVENT, OTA_EVENT_CANCELLED, NULL, 0, 0);
     } else {
         ESP_LOGE(TAG, "Firmware upgrade failed");
+        esp_event_post(OTA_EVENT, OTA_EVENT_FAILED, &ret, sizeof(ret), 0);
+    }
+}
+
+static void ota_task(void * args)
+{
+    ota_update();
+    // Si no se ha reiniciado es que la actualización ha fallado o se ha cancelado
+    diagnostics_task_exit();
+    portENTER_CRITICAL(&ota_task_mux);
+    ota_task_running = false;
+    portEXIT_CRITICAL(&ota_task_mux);
+    vTaskDelete(NULL);
+}
+
+void ota_update_start()
+{
+    // Solo permitimos una actualización a la vez (pulsaciones repetidas del botón no lanzan otra)
+    portENTER_CRITICAL(&ota_task_mux);
+    bool running = ota_task_running;
+    ota_task_running = true;
+    portEXIT_CRITICAL(&ota_task_mux);
+    if (running) {
+        ESP_LOGW(TAG, "OTA update already in progress");
+        return;
+    }
+    /* La actualización corre en una tarea de baja prioridad para que el muestreo (y el resto de la
+    aplicación) no se retrase mientras se descarga y escribe la imagen.*/
+    if (task_plan_create(TASK_PLAN_OTA, ota_task, "OTA update task", OTA_TASK_STACK_SIZE, NULL, NULL) != pdPASS) {
+        portENTER_CRITICAL(&ota_task_mux);
+        ota_task_running = false;
+        portEXIT_CRITICAL(&ota_task_mux);
+        ESP_LOGE(TAG, "Can't create OTA update task");
+    }
+}
+
+void ota_update_cancel()
+{
+    if (ota_task_running) ota_cancel_requested = true;
+}
+
+static void ota_check_task(void * args)
+{
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(OTA_CHECK_PERIOD_SEC * 1000));
+        // La comprobación es una petición HEAD: solo se descarga la imagen si ha cambiado
+        bool available = false;
+        if (!ota_task_running && ota_check_update(&available) == ESP_OK && available) {
+            ESP_LOGI(TAG, "New firmware available");
+            ota_update_start();
+        }
     }
 }
 
@@ -127,24 +691,108 @@ static void print_sha256(const uint8_t *image_hash, const char *label)
     ESP_LOGI(TAG, "%s %s", label, hash_print);
 }
 
-static void get_sha256_of_partitions(void)
+static void compute_sha256_of_partitions(struct sha256_cache * cache)
 {
-    uint8_t sha_256[HASH_LEN] = { 0 };
     esp_partition_t partition;
 
     // get sha256 digest for bootloader
     partition.address   = ESP_BOOTLOADER_OFFSET;
     partition.size      = ESP_PARTITION_TABLE_OFFSET;
     partition.type      = ESP_PARTITION_TYPE_APP;
-    esp_partition_get_sha256(&partition, sha_256);
-    print_sha256(sha_256, "SHA-256 for bootloader: ");
+    esp_partition_get_sha256(&partition, cache->bootloader_sha);
 
     // get sha256 digest for running partition
-    esp_partition_get_sha256(esp_ota_get_running_partition(), sha_256);
-    print_sha256(sha_256, "SHA-256 for current firmware: ");
+    esp_partition_get_sha256(esp_ota_get_running_partition(), cache->firmware_sha);
+}
+
+static bool load_sha256_cache(struct sha256_cache * cache)
+{
+    nvs_handle_t nvs_handle;
+    // Si no hay nada guardado todavía (primer arranque) no hay caché que leer
+    if (nvs_open(SHA256_CACHE_NAMESPACE, NVS_READONLY, &nvs_handle) != ESP_OK) return false;
+    size_t size = sizeof(struct sha256_cache);
+    esp_err_t err = nvs_get_blob(nvs_handle, SHA256_CACHE_KEY, cache, &size);
+    nvs_close(nvs_handle);
+    return err == ESP_OK && size == sizeof(struct sha256_cache);
+}
+
+static void save_sha256_cache(const struct sha256_cache * cache)
+{
+    nvs_handle_t nvs_handle;
+    ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_open(SHA256_CACHE_NAMESPACE, NVS_READWRITE, &nvs_handle));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_set_blob(nvs_handle, SHA256_CACHE_KEY, cache, sizeof(struct sha256_cache)));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_commit(nvs_handle));
+    nvs_close(nvs_handle);
+}
+
+static void fill_sha256_cache_key(struct sha256_cache * cache)
+{
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    /* La clave de la caché identifica a la imagen en ejecución: dirección y tamaño de la partición
+    y SHA-256 del ELF que el propio build deja en la descripción de la aplicación (leerla no toca la flash completa)*/
+    cache->partition_address = running->address;
+    cache->partition_size = running->size;
+    memcpy(cache->elf_sha, esp_ota_get_app_description()->app_elf_sha256, HASH_LEN);
+}
+
+void ota_print_sha256_of_partitions(bool force_compute)
+{
+    struct sha256_cache cached;
+    struct sha256_cache current = { 0 };
+    fill_sha256_cache_key(&current);
+    /* Solo recalculamos los hashes (recorriendo el bootloader y la partición completa) si nos lo piden
+    o si la imagen en ejecución no es la misma con la que se guardó la caché*/
+    if (!force_compute && load_sha256_cache(&cached) && cached.partition_address == current.partition_address
+        && cached.partition_size == current.partition_size && memcmp(cached.elf_sha, current.elf_sha, HASH_LEN) == 0) {
+        ESP_LOGI(TAG, "Using cached SHA-256 digests");
+        current = cached;
+    }
+    else {
+        compute_sha256_of_partitions(&current);
+        save_sha256_cache(&current);
+    }
+    print_sha256(current.bootloader_sha, "SHA-256 for bootloader: ");
+    print_sha256(current.firmware_sha, "SHA-256 for current firmware: ");
+}
+
+/* Guarda en la caché los hashes de una imagen recién escrita en "partition", calculados durante la descarga,
+para que su primer arranque no tenga que recalcularlos. El bootloader no cambia, así que se reutiliza su hash.*/
+static void seed_sha256_cache(const esp_partition_t * partition, const uint8_t * elf_sha, const uint8_t * firmware_sha)
+{
+    struct sha256_cache cache;
+    if (!load_sha256_cache(&cache)) return;
+    cache.partition_address = partition->address;
+    cache.partition_size = partition->size;
+    memcpy(cache.elf_sha, elf_sha, HASH_LEN);
+    memcpy(cache.firmware_sha, firmware_sha, HASH_LEN);
+    save_sha256_cache(&cache);
+}
+
+static int do_ota_sha256(int argc, char **argv)
+{
+    // Desde la consola forzamos el recálculo de los hashes (y se actualiza la caché)
+    ota_print_sha256_of_partitions(true);
+    return 0;
+}
+
+void register_ota()
+{
+    // Configuración del comando "ota_sha256" que vamos a registrar
+    const esp_console_cmd_t ota_sha256_cmd = {
+        .command = "ota_sha256",
+        .help = "Recompute SHA-256 of bootloader and running firmware and refresh the NVS cache",
+        .hint = NULL,
+        .func = &do_ota_sha256,
+        .argtable = NULL
+    };
+    // Registramos el comando en la consola
+    ESP_ERROR_CHECK(esp_console_cmd_register(&ota_sha256_cmd));
 }
 
 void ota_init(void){
+    // Antes de que pueda empezar ninguna transferencia (por HTTP o por UART)
+    static StaticSemaphore_t transfer_lock_buffer;
+    transfer_lock = xSemaphoreCreateMutexStatic(&transfer_lock_buffer);
     // Initialize NVS.
     esp_err_t err = nvs_flash_init();
     if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
@@ -157,7 +805,17 @@ void ota_init(void){
     }
     ESP_ERROR_CHECK(err);
 
-    get_sha256_of_partitions();
+    /* Mostramos los hashes de bootloader y firmware. Se toman de la caché en NVS salvo que la imagen
+    haya cambiado desde el último arranque, evitando recorrer toda la partición en cada inicio.*/
+    ota_print_sha256_of_partitions(false);
+    // Anotamos la imagen revertida en el arranque anterior, si la hubo
+    record_rejected_image();
+
+    // Avisamos si hay una descarga interrumpida que se reanudará en la próxima actualización
+    struct ota_progress progress;
+    if (load_ota_progress(&progress)) {
+        ESP_LOGI(TAG, "Interrupted OTA download at %u/%u bytes will be resumed", progress.bytes_written, progress.image_size);
+    }
 
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
@@ -167,14 +825,12 @@ void ota_init(void){
      * examples/protocols/README.md for more information about this function.
      */
     ESP_ERROR_CHECK(example_connect());
-
-#if CONFIG_EXAMPLE_CONNECT_WIFI
-    /* Ensure to disable any WiFi power save mode, this allows best throughput
-     * and hence timings for overall OTA operation.
-     */
-    esp_wifi_set_ps(WIFI_PS_NONE);
-#endif // CONFIG_EXAMPLE_CONNECT_WIFI
-
+    // Comprobación periódica de versión en segundo plano (con la prioridad baja de las actualizaciones)
+    if (OTA_CHECK_PERIOD_SEC > 0) {
+        task_plan_create(TASK_PLAN_OTA, ota_check_task, "OTA check task", OTA_TASK_STACK_SIZE, NULL, NULL);
+    }
+    /* El ahorro de energía del Wi-Fi se mantiene activo; solo se desactiva durante la transferencia
+    de una actualización (ver ota_update()).*/
 }
 
 void verify_image(bool (*diagnostic)()){
@@ -1,6 +1,59 @@
 #ifndef OTA_H
 #define OTA_H
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <esp_err.h>
+#include <esp_event.h>
+// Base de eventos de la actualización OTA (se emiten en el bucle de eventos por defecto)
+ESP_EVENT_DECLARE_BASE(OTA_EVENT);
+// Identificadores de los eventos de la actualización
+enum {
+    OTA_EVENT_STARTED,
+    // Lleva como dato una struct ota_progress_event
+    OTA_EVENT_PROGRESS,
+    OTA_EVENT_FINISHED,
+    // Lleva como dato el esp_err_t del fallo
+    OTA_EVENT_FAILED,
+    OTA_EVENT_CANCELLED
+};
+// Dato de los eventos de progreso
+struct ota_progress_event {
+    uint32_t bytes_done;
+    uint32_t bytes_total;
+};
 void ota_init();
+// Descarga e instala la nueva imagen de forma bloqueante (reinicia si tiene éxito)
 void ota_update();
+// Lanza la actualización en una tarea de baja prioridad en segundo plano y vuelve inmediatamente
+void ota_update_start();
+// Pide cancelar la actualización en segundo plano (se podrá reanudar más adelante)
+void ota_update_cancel();
+/* Pregunta al servidor (petición HEAD con If-None-Match, reutilizando la conexión y la sesión TLS)
+si hay una imagen distinta de la instalada, sin descargarla*/
+esp_err_t ota_check_update(bool * available);
+// Copia en "etag" el ETag de la imagen en ejecución si la instaló una actualización (cadena vacía si no)
+void ota_get_installed_etag(char * etag, size_t size);
+/* Copia el ETag y la versión de la última imagen revertida (autotest fallido o rollback), cadenas vacías
+si no se conocen. Devuelve false si no hay ninguna anotada*/
+bool ota_get_rejected_image(char * etag, size_t etag_size, char * version, size_t version_size);
+// Olvida la imagen revertida (el servidor ya ofrece otra)
+void ota_clear_rejected_image();
+/* Reserva la partición OTA pasiva para una transferencia completa (descarga HTTP o recepción por UART),
+de forma que nunca haya dos escribiéndola a la vez. Devuelve false si ya hay otra en curso*/
+bool ota_transfer_lock();
+// Libera la partición pasiva al acabar (o fallar) la transferencia
+void ota_transfer_unlock();
+/* Olvida el progreso guardado de una descarga HTTP interrumpida. Lo llama cualquier otra transferencia
+antes de escribir en la partición pasiva: lo ya descargado deja de estar allí*/
+void clear_ota_progress();
+/* Arranca la recepción de imágenes por UART (alternativa sin red a la descarga HTTPS). La imagen se
+escribe en la partición OTA pasiva y tras reiniciar pasa por la misma verificación (verify_image)*/
+void ota_uart_start();
 void verify_image(bool (*diagnostic)());
+/* Muestra los SHA-256 de bootloader y firmware en ejecución. Usa los guardados en NVS salvo
+que la imagen haya cambiado o se fuerce el recálculo con "force_compute"*/
+void ota_print_sha256_of_partitions(bool force_compute);
+// Registra el comando de consola "ota_sha256" que recalcula los hashes bajo demanda
+void register_ota();
 #endif
\ No newline at end of file
@@ -0,0 +1,263 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_ota_ops.h>
+#include <esp_tls.h>
+#include <nvs.h>
+#include "ota.h"
+
+// URL del endpoint con el que se comprueba si hay una versión nueva
+#define OTA_CHECK_URL CONFIG_OTA_CHECK_URL
+// Tamaño máximo de la respuesta (solo cabeceras) a la petición HEAD
+#define RESPONSE_SIZE 1024
+// Tamaño máximo de la petición HEAD
+#define REQUEST_SIZE 512
+// Tamaño máximo de un ETag y de una versión en las cabeceras
+#define ETAG_SIZE 64
+#define VERSION_SIZE 32
+// Timeout de red de la comprobación
+#define CHECK_TIMEOUT_MS 10000
+// Clave de la NVS con la sesión TLS serializada (en el espacio de nombres de las descargas)
+#define SESSION_NAMESPACE "ota_dl"
+#define SESSION_KEY "tls_session"
+#define SESSION_MAX_SIZE 512
+
+static const char *TAG = "OTA check";
+extern const uint8_t server_cert_pem_start[] asm("_binary_ca_cert_pem_start");
+extern const uint8_t server_cert_pem_end[] asm("_binary_ca_cert_pem_end");
+
+// Conexión TLS que se mantiene abierta entre comprobaciones (keep-alive)
+static esp_tls_t * check_conn = NULL;
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+// Última sesión TLS negociada: permite reanudar sin el handshake completo si se cae la conexión
+static esp_tls_client_session_t * saved_session = NULL;
+#endif
+
+// Separa la URL en servidor, puerto y ruta
+static bool parse_url(const char * url, char * host, size_t host_size, int * port, const char ** path);
+// Abre la conexión TLS reutilizando la sesión guardada si la hay
+static esp_err_t open_connection(const char * host, int port);
+// Cierra la conexión persistente
+static void close_connection();
+// Envía la petición HEAD y lee las cabeceras de la respuesta
+static esp_err_t send_head(const char * host, const char * path, const char * etag, char * response, size_t size);
+// Busca el valor de una cabecera en la respuesta
+static bool get_header(const char * response, const char * name, char * value, size_t size);
+// Indica si el servidor ofrece la imagen revertida en un arranque anterior (si ofrece otra, olvida el rechazo)
+static bool offers_rejected_image(const char * etag, const char * version);
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+// Guarda en RAM y en NVS la sesión de la conexión actual
+static void store_session();
+// Recupera de NVS la sesión de un arranque anterior
+static void load_session();
+#endif
+
+
+static bool parse_url(const char * url, char * host, size_t host_size, int * port, const char ** path){
+    const char * prefix = "https://";
+    if (strncmp(url, prefix, strlen(prefix)) != 0) return false;
+    const char * start = url + strlen(prefix);
+    const char * end = start + strcspn(start, ":/");
+    if (end == start || (size_t) (end - start) >= host_size) return false;
+    memcpy(host, start, end - start);
+    host[end - start] = '\0';
+    *port = 443;
+    if (*end == ':') *port = atoi(end + 1);
+    *path = strchr(end, '/');
+    if (*path == NULL) *path = "/";
+    return true;
+}
+
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+static void store_session(){
+    esp_tls_client_session_t * session = esp_tls_get_client_session(check_conn);
+    if (session == NULL) return;
+    if (saved_session != NULL) {
+        mbedtls_ssl_session_free(&saved_session->saved_session);
+        free(saved_session);
+    }
+    saved_session = session;
+    // La serializamos en NVS para poder reanudarla también tras un reinicio o deep sleep
+    uint8_t buf[SESSION_MAX_SIZE];
+    size_t len = 0;
+    if (mbedtls_ssl_session_save(&session->saved_session, buf, sizeof(buf), &len) != 0) return;
+    nvs_handle_t nvs_handle;
+    if (nvs_open(SESSION_NAMESPACE, NVS_READWRITE, &nvs_handle) != ESP_OK) return;
+    ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_set_blob(nvs_handle, SESSION_KEY, buf, len));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_commit(nvs_handle));
+    nvs_close(nvs_handle);
+}
+
+static void load_session(){
+    nvs_handle_t nvs_handle;
+    if (nvs_open(SESSION_NAMESPACE, NVS_READONLY, &nvs_handle) != ESP_OK) return;
+    uint8_t buf[SESSION_MAX_SIZE];
+    size_t len = sizeof(buf);
+    esp_err_t err = nvs_get_blob(nvs_handle, SESSION_KEY, buf, &len);
+    nvs_close(nvs_handle);
+    if (err != ESP_OK) return;
+    esp_tls_client_session_t * session = calloc(1, sizeof(esp_tls_client_session_t));
+    if (session == NULL) return;
+    mbedtls_ssl_session_init(&session->saved_session);
+    if (mbedtls_ssl_session_load(&session->saved_session, buf, len) != 0) {
+        mbedtls_ssl_session_free(&session->saved_session);
+        free(session);
+        return;
+    }
+    saved_session = session;
+}
+#endif
+
+static esp_err_t open_connection(const char * host, int port){
+    esp_tls_cfg_t cfg = {
+        .cacert_buf = server_cert_pem_start,
+        .cacert_bytes = server_cert_pem_end - server_cert_pem_start,
+        .timeout_ms = CHECK_TIMEOUT_MS,
+#ifdef CONFIG_EXAMPLE_SKIP_COMMON_NAME_CHECK
+        .skip_common_name = true,
+#endif
+    };
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    // La primera comprobación tras arrancar intenta reanudar la sesión guardada en NVS
+    static bool session_loaded = false;
+    if (!session_loaded) {
+        load_session();
+        session_loaded = true;
+    }
+    cfg.client_session = saved_session;
+#endif
+    check_conn = esp_tls_init();
+    if (check_conn == NULL) return ESP_ERR_NO_MEM;
+    int64_t start = esp_timer_get_time();
+    if (esp_tls_conn_new_sync(host, strlen(host), port, &cfg, check_conn) != 1) {
+        ESP_LOGE(TAG, "TLS connection to %s:%d failed", host, port);
+        close_connection();
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "TLS handshake in %lld ms%s", (esp_timer_get_time() - start) / 1000,
+             cfg.client_session != NULL ? " (session resumption offered)" : "");
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    store_session();
+#endif
+    return ESP_OK;
+}
+
+static void close_connection(){
+    if (check_conn != NULL) esp_tls_conn_destroy(check_conn);
+    check_conn = NULL;
+}
+
+static esp_err_t send_head(const char * host, const char * path, const char * etag, char * response, size_t size){
+    char request[REQUEST_SIZE];
+    int len = snprintf(request, sizeof(request),
+                       "HEAD %s HTTP/1.1\r\nHost: %s\r\nUser-Agent: ESP32 OTA check\r\nConnection: keep-alive\r\n"
+                       "%s%s%s\r\n", path, host, etag[0] != '\0' ? "If-None-Match: " : "", etag, etag[0] != '\0' ? "\r\n" : "");
+    if (len <= 0 || len >= sizeof(request)) return ESP_ERR_INVALID_SIZE;
+    if (esp_tls_conn_write(check_conn, request, len) != len) return ESP_FAIL;
+    // Una respuesta a HEAD no tiene cuerpo: leemos hasta la línea vacía que cierra las cabeceras
+    size_t filled = 0;
+    response[0] = '\0';
+    while (strstr(response, "\r\n\r\n") == NULL) {
+        if (filled >= size - 1) return ESP_ERR_INVALID_SIZE;
+        int read = esp_tls_conn_read(check_conn, response + filled, size - 1 - filled);
+        if (read <= 0) return ESP_FAIL;
+        filled += read;
+        response[filled] = '\0';
+    }
+    return ESP_OK;
+}
+
+static bool get_header(const char * response, const char * name, char * value, size_t size){
+    size_t name_len = strlen(name);
+    for (const char * line = strstr(response, "\r\n"); line != NULL; line = strstr(line, "\r\n")) {
+        line += 2;
+        if (strncasecmp(line, name, name_len) == 0 && line[name_len] == ':') {
+            const char * start = line + name_len + 1;
+            while (*start == ' ') start++;
+            size_t len = strcspn(start, "\r\n");
+            if (len >= size) len = size - 1;
+            memcpy(value, start, len);
+            value[len] = '\0';
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool offers_rejected_image(const char * etag, const char * version){
+    char rejected_etag[ETAG_SIZE];
+    char rejected_version[VERSION_SIZE];
+    if (!ota_get_rejected_image(rejected_etag, sizeof(rejected_etag), rejected_version, sizeof(rejected_version))) {
+        return false;
+    }
+    bool same;
+    if (etag[0] != '\0' && rejected_etag[0] != '\0') same = strcmp(etag, rejected_etag) == 0;
+    else if (version[0] != '\0' && rejected_version[0] != '\0') same = strcmp(version, rejected_version) == 0;
+    // Sin nada con que comparar no sabemos si es otra imagen: mejor no arriesgarse a otro rollback
+    else same = true;
+    if (!same) ota_clear_rejected_image();
+    return same;
+}
+
+esp_err_t ota_check_update(bool * available){
+    char host[64];
+    int port;
+    const char * path;
+    if (!parse_url(OTA_CHECK_URL, host, sizeof(host), &port, &path)) {
+        ESP_LOGE(TAG, "Unsupported check url %s", OTA_CHECK_URL);
+        return ESP_ERR_INVALID_ARG;
+    }
+    // ETag de la imagen instalada: el servidor contesta 304 si sigue siendo la misma
+    char installed_etag[ETAG_SIZE];
+    ota_get_installed_etag(installed_etag, sizeof(installed_etag));
+    char * response = malloc(RESPONSE_SIZE);
+    if (response == NULL) return ESP_ERR_NO_MEM;
+    esp_err_t err = ESP_FAIL;
+    // Primero probamos por la conexión abierta; si el servidor la ha cerrado abrimos otra (una vez)
+    for (int attempt = 0; attempt < 2 && err != ESP_OK; attempt++) {
+        if (check_conn == NULL && open_connection(host, port) != ESP_OK) break;
+        err = send_head(host, path, installed_etag, response, RESPONSE_SIZE);
+        if (err != ESP_OK) close_connection();
+    }
+    if (err != ESP_OK) {
+        free(response);
+        return err;
+    }
+    int status = 0;
+    sscanf(response, "HTTP/1.%*d %d", &status);
+    char version[VERSION_SIZE] = "";
+    char etag[ETAG_SIZE] = "";
+    *available = false;
+    if (status == 304) {
+        ESP_LOGI(TAG, "Firmware not modified");
+    }
+    else if (status == 200) {
+        // Si el servidor anuncia la versión, solo hay actualización si es distinta de la que corre
+        if (get_header(response, "X-App-Version", version, sizeof(version))) {
+            *available = strcmp(version, esp_ota_get_app_description()->version) != 0;
+            ESP_LOGI(TAG, "Server version %s, running %s", version, esp_ota_get_app_description()->version);
+        }
+        else {
+            *available = true;
+        }
+        // Una imagen que ya se instaló y se revirtió no se vuelve a ofrecer hasta que el servidor tenga otra
+        get_header(response, "ETag", etag, sizeof(etag));
+        if (*available && offers_rejected_image(etag, version)) {
+            ESP_LOGW(TAG, "Server still offers the rolled back image, skipping it");
+            *available = false;
+        }
+    }
+    else {
+        ESP_LOGE(TAG, "Unexpected status %d in version check", status);
+        err = ESP_FAIL;
+    }
+    char connection[16];
+    if (get_header(response, "Connection", connection, sizeof(connection)) && strcasecmp(connection, "close") == 0) {
+        close_connection();
+    }
+    free(response);
+    return err;
+}
@@ -0,0 +1,270 @@
+#include <string.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_ota_ops.h>
+#include "esp32/rom/miniz.h"
+#include "ota_package.h"
+
+// Longitud del SHA-256 del ELF que identifica la imagen base de un parche
+#define ELF_SHA_LEN 32
+// Operaciones de un parche delta: copiar de la imagen base o insertar bytes nuevos
+#define DELTA_OP_COPY 'C'
+#define DELTA_OP_INSERT 'I'
+// Tamaño del buffer para copiar trozos de la imagen base a la partición destino
+#define COPY_BUF_SIZE 1024
+
+static const char *TAG = "OTA package";
+
+// Cabecera (sin comprimir) de un paquete OTA; le sigue un flujo zlib con la imagen o el parche
+struct ota_package_header {
+    uint32_t magic;
+    uint8_t type;
+    uint8_t reserved[3];
+    // Tamaño de la imagen resultante
+    uint32_t image_size;
+    // SHA-256 del ELF de la imagen base (solo para parches delta)
+    uint8_t base_elf_sha[ELF_SHA_LEN];
+} __attribute__((packed));
+
+// Estados del intérprete de operaciones de un parche delta
+enum delta_state {
+    DELTA_READ_OP,
+    DELTA_READ_ARGS,
+    DELTA_INSERT_DATA
+};
+
+struct ota_package {
+    esp_ota_handle_t ota_handle;
+    const esp_partition_t * base;
+    struct ota_package_header header;
+    size_t header_filled;
+    // Descompresor de la ROM y su diccionario circular de 32 KB
+    tinfl_decompressor inflator;
+    uint8_t * dict;
+    size_t dict_ofs;
+    bool stream_done;
+    // Estado del intérprete del parche
+    enum delta_state state;
+    uint8_t op;
+    uint8_t args[8];
+    size_t args_filled;
+    uint32_t insert_remaining;
+    uint8_t copy_buf[COPY_BUF_SIZE];
+    // Contadores para el informe de rendimiento al terminar
+    uint32_t compressed_bytes;
+    uint32_t image_bytes;
+    int64_t start_time;
+};
+
+// Escribe "len" bytes de la imagen resultante comprobando que no se excede su tamaño anunciado
+static esp_err_t write_image(ota_package_handle_t package, const uint8_t * data, size_t len);
+// Copia "len" bytes de la imagen base desde "offset" a la imagen resultante
+static esp_err_t copy_from_base(ota_package_handle_t package, uint32_t offset, uint32_t len);
+// Interpreta los bytes descomprimidos de un parche delta
+static esp_err_t apply_delta(ota_package_handle_t package, const uint8_t * data, size_t len);
+// Comprueba la cabecera una vez completa
+static esp_err_t check_header(ota_package_handle_t package);
+
+
+bool ota_package_detect(const uint8_t * data, size_t len){
+    uint32_t magic;
+    if (len < sizeof(magic)) return false;
+    memcpy(&magic, data, sizeof(magic));
+    return magic == OTA_PACKAGE_MAGIC;
+}
+
+ota_package_handle_t ota_package_begin(const esp_partition_t * target, const esp_partition_t * base){
+    ota_package_handle_t package = calloc(1, sizeof(struct ota_package));
+    if (package == NULL) return NULL;
+    package->dict = malloc(TINFL_LZ_DICT_SIZE);
+    if (package->dict == NULL) {
+        free(package);
+        return NULL;
+    }
+    // Con escrituras secuenciales solo se borra cada sector al llegar a él
+    if (esp_ota_begin(target, OTA_WITH_SEQUENTIAL_WRITES, &package->ota_handle) != ESP_OK) {
+        free(package->dict);
+        free(package);
+        return NULL;
+    }
+    package->base = base;
+    package->state = DELTA_READ_OP;
+    package->start_time = esp_timer_get_time();
+    return package;
+}
+
+static esp_err_t check_header(ota_package_handle_t package){
+    struct ota_package_header * header = &package->header;
+    if (header->magic != OTA_PACKAGE_MAGIC) {
+        ESP_LOGE(TAG, "Bad package magic 0x%08x", header->magic);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (header->type == OTA_PACKAGE_DELTA) {
+        // Un parche solo es válido sobre la imagen exacta con la que se generó
+        if (memcmp(header->base_elf_sha, esp_ota_get_app_description()->app_elf_sha256, ELF_SHA_LEN) != 0) {
+            ESP_LOGE(TAG, "Delta patch was made for another base image");
+            return ESP_ERR_INVALID_VERSION;
+        }
+    }
+    else if (header->type != OTA_PACKAGE_FULL) {
+        ESP_LOGE(TAG, "Unknown package type %u", header->type);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (header->image_size == 0) {
+        ESP_LOGE(TAG, "Empty image in package");
+        return ESP_ERR_INVALID_SIZE;
+    }
+    ESP_LOGI(TAG, "%s package, image size %u bytes", header->type == OTA_PACKAGE_DELTA ? "Delta" : "Compressed",
+             header->image_size);
+    tinfl_init(&package->inflator);
+    return ESP_OK;
+}
+
+static esp_err_t write_image(ota_package_handle_t package, const uint8_t * data, size_t len){
+    if (package->image_bytes + len > package->header.image_size) {
+        ESP_LOGE(TAG, "Package produces more data than the announced image size");
+        return ESP_ERR_INVALID_SIZE;
+    }
+    package->image_bytes += len;
+    return esp_ota_write(package->ota_handle, data, len);
+}
+
+static esp_err_t copy_from_base(ota_package_handle_t package, uint32_t offset, uint32_t len){
+    if (offset + len > package->base->size) return ESP_ERR_INVALID_SIZE;
+    while (len > 0) {
+        uint32_t chunk = len < COPY_BUF_SIZE ? len : COPY_BUF_SIZE;
+        esp_err_t err = esp_partition_read(package->base, offset, package->copy_buf, chunk);
+        if (err == ESP_OK) err = write_image(package, package->copy_buf, chunk);
+        if (err != ESP_OK) return err;
+        offset += chunk;
+        len -= chunk;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t apply_delta(ota_package_handle_t package, const uint8_t * data, size_t len){
+    esp_err_t err = ESP_OK;
+    while (len > 0 && err == ESP_OK) {
+        switch (package->state) {
+            case DELTA_READ_OP:
+                package->op = *data++;
+                len--;
+                if (package->op != DELTA_OP_COPY && package->op != DELTA_OP_INSERT) {
+                    ESP_LOGE(TAG, "Invalid delta operation 0x%02x", package->op);
+                    return ESP_ERR_INVALID_ARG;
+                }
+                package->args_filled = 0;
+                package->state = DELTA_READ_ARGS;
+                break;
+            case DELTA_READ_ARGS: {
+                // La copia lleva origen y longitud; la inserción solo la longitud (enteros de 32 bits little endian)
+                size_t args_len = package->op == DELTA_OP_COPY ? 8 : 4;
+                size_t n = args_len - package->args_filled;
+                if (n > len) n = len;
+                memcpy(package->args + package->args_filled, data, n);
+                package->args_filled += n;
+                data += n;
+                len -= n;
+                if (package->args_filled < args_len) break;
+                if (package->op == DELTA_OP_COPY) {
+                    uint32_t offset, length;
+                    memcpy(&offset, package->args, 4);
+                    memcpy(&length, package->args + 4, 4);
+                    err = copy_from_base(package, offset, length);
+                    package->state = DELTA_READ_OP;
+                }
+                else {
+                    memcpy(&package->insert_remaining, package->args, 4);
+                    package->state = package->insert_remaining > 0 ? DELTA_INSERT_DATA : DELTA_READ_OP;
+                }
+                break;
+            }
+            case DELTA_INSERT_DATA: {
+                size_t n = package->insert_remaining < len ? package->insert_remaining : len;
+                err = write_image(package, data, n);
+                package->insert_remaining -= n;
+                data += n;
+                len -= n;
+                if (package->insert_remaining == 0) package->state = DELTA_READ_OP;
+                break;
+            }
+        }
+    }
+    return err;
+}
+
+esp_err_t ota_package_write(ota_package_handle_t package, const uint8_t * data, size_t len){
+    package->compressed_bytes += len;
+    // Los primeros bytes del paquete son la cabecera sin comprimir
+    if (package->header_filled < sizeof(struct ota_package_header)) {
+        size_t n = sizeof(struct ota_package_header) - package->header_filled;
+        if (n > len) n = len;
+        memcpy((uint8_t *) &package->header + package->header_filled, data, n);
+        package->header_filled += n;
+        data += n;
+        len -= n;
+        if (package->header_filled < sizeof(struct ota_package_header)) return ESP_OK;
+        esp_err_t err = check_header(package);
+        if (err != ESP_OK) return err;
+    }
+    /* Descomprimimos sobre el diccionario circular: cada trozo de salida se escribe (imagen completa)
+    o se interpreta (parche) antes de que el descompresor vuelva a sobrescribirlo*/
+    while (!package->stream_done) {
+        size_t in_bytes = len;
+        size_t out_bytes = TINFL_LZ_DICT_SIZE - package->dict_ofs;
+        tinfl_status status = tinfl_decompress(&package->inflator, data, &in_bytes, package->dict,
+                                               package->dict + package->dict_ofs, &out_bytes,
+                                               TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_HAS_MORE_INPUT);
+        data += in_bytes;
+        len -= in_bytes;
+        if (out_bytes > 0) {
+            uint8_t * out = package->dict + package->dict_ofs;
+            esp_err_t err = package->header.type == OTA_PACKAGE_DELTA ? apply_delta(package, out, out_bytes)
+                                                                      : write_image(package, out, out_bytes);
+            if (err != ESP_OK) return err;
+            package->dict_ofs = (package->dict_ofs + out_bytes) & (TINFL_LZ_DICT_SIZE - 1);
+        }
+        if (status < TINFL_STATUS_DONE) {
+            ESP_LOGE(TAG, "Decompression error %d", status);
+            return ESP_FAIL;
+        }
+        if (status == TINFL_STATUS_DONE) package->stream_done = true;
+        // Si necesita más entrada y ya no queda, esperamos al siguiente trozo de la descarga
+        else if (status == TINFL_STATUS_NEEDS_MORE_INPUT && len == 0) break;
+    }
+    return ESP_OK;
+}
+
+esp_err_t ota_package_finish(ota_package_handle_t package){
+    esp_err_t err = ESP_OK;
+    if (!package->stream_done || package->image_bytes != package->header.image_size
+        || package->state != DELTA_READ_OP) {
+        ESP_LOGE(TAG, "Incomplete package (%u/%u image bytes)", package->image_bytes, package->header.image_size);
+        esp_ota_abort(package->ota_handle);
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    else {
+        err = esp_ota_end(package->ota_handle);
+    }
+    if (err == ESP_OK) {
+        // Informe de rendimiento: bytes descargados frente a bytes de imagen generados
+        int64_t elapsed_us = esp_timer_get_time() - package->start_time;
+        if (elapsed_us <= 0) elapsed_us = 1;
+        // Negativo si el paquete es mayor que la imagen (imagen incompresible o delta con poca reutilización)
+        int saved_pct = 100 - (int) ((int64_t) package->compressed_bytes * 100 / package->image_bytes);
+        ESP_LOGI(TAG, "Package %u bytes -> image %u bytes (%d%% of download saved) in %lld ms",
+                 package->compressed_bytes, package->image_bytes, saved_pct, elapsed_us / 1000);
+        ESP_LOGI(TAG, "Throughput: %lld KB/s downloaded, %lld KB/s written to flash",
+                 (int64_t) package->compressed_bytes * 1000000 / 1024 / elapsed_us,
+                 (int64_t) package->image_bytes * 1000000 / 1024 / elapsed_us);
+    }
+    free(package->dict);
+    free(package);
+    return err;
+}
+
+void ota_package_abort(ota_package_handle_t package){
+    esp_ota_abort(package->ota_handle);
+    free(package->dict);
+    free(package);
+}
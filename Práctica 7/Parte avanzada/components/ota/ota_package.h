@@ -0,0 +1,34 @@
+#ifndef OTA_PACKAGE_H
+#define OTA_PACKAGE_H
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+
+// Número mágico con el que empieza un paquete OTA comprimido ("AOTA" en little endian)
+#define OTA_PACKAGE_MAGIC 0x41544F41
+
+// Tipos de contenido de un paquete OTA
+enum ota_package_type {
+    // Imagen completa comprimida con zlib
+    OTA_PACKAGE_FULL = 1,
+    // Parche binario comprimido con zlib respecto a la imagen en ejecución
+    OTA_PACKAGE_DELTA = 2
+};
+
+// Decodificador de paquetes OTA (la estructura es privada del módulo)
+typedef struct ota_package * ota_package_handle_t;
+
+// Indica si los primeros bytes recibidos ("len" al menos 4) corresponden a un paquete OTA en lugar de a una imagen sin comprimir
+bool ota_package_detect(const uint8_t * data, size_t len);
+/* Prepara la escritura en "target" de la imagen contenida en un paquete. Los parches delta se aplican
+sobre la imagen de la partición "base" (la que está en ejecución)*/
+ota_package_handle_t ota_package_begin(const esp_partition_t * target, const esp_partition_t * base);
+// Procesa los siguientes "len" bytes del paquete: se descomprimen y se escriben en la partición destino
+esp_err_t ota_package_write(ota_package_handle_t package, const uint8_t * data, size_t len);
+// Comprueba que el paquete estaba completo, cierra la escritura OTA y libera el decodificador
+esp_err_t ota_package_finish(ota_package_handle_t package);
+// Libera el decodificador descartando la imagen a medio escribir
+void ota_package_abort(ota_package_handle_t package);
+#endif
@@ -0,0 +1,301 @@
+#include <string.h>
+#include <esp_log.h>
+#include <esp_event.h>
+#include <esp_system.h>
+#include <esp_ota_ops.h>
+#include <esp_rom_crc.h>
+#include <driver/uart.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "ota.h"
+#include "ota_writer.h"
+#include "task_plan.h"
+
+// Puerto, velocidad y pines de la UART por la que se reciben las imágenes
+#define OTA_UART_NUM CONFIG_OTA_UART_NUM
+#define OTA_UART_BAUD CONFIG_OTA_UART_BAUD
+#define OTA_UART_TX_IO CONFIG_OTA_UART_TX_IO
+#define OTA_UART_RX_IO CONFIG_OTA_UART_RX_IO
+// Buffer de recepción del driver: limita cuántas tramas puede tener el emisor en vuelo (ventana)
+#define OTA_UART_RX_BUF_SIZE (16 * 1024)
+// Tiempo máximo sin recibir una trama durante una transferencia antes de abandonarla
+#define OTA_UART_TIMEOUT_MS 3000
+// Pila de la tarea receptora (su prioridad y núcleo salen de la tabla de tareas)
+#define OTA_UART_TASK_STACK_SIZE 4096
+
+/* Trama: SOF, tipo, longitud del payload (u16), número de secuencia (u32), payload y CRC-32 (u32) del
+tipo, la longitud, la secuencia y el payload. Todos los enteros son little endian.*/
+#define FRAME_SOF 0xA5
+#define FRAME_HEADER_SIZE 8
+#define FRAME_CRC_SIZE 4
+#define FRAME_MAX_PAYLOAD SPI_FLASH_SEC_SIZE
+// Tipos de trama
+#define FRAME_START 'S'
+#define FRAME_DATA 'D'
+#define FRAME_END 'E'
+#define FRAME_ABORT 'X'
+#define FRAME_ACK 'A'
+#define FRAME_NAK 'N'
+// Cada cuántos puntos porcentuales se emite un evento de progreso
+#define PROGRESS_EVENT_STEP 5
+
+static const char *TAG = "OTA UART";
+
+struct frame {
+    uint8_t type;
+    uint16_t len;
+    uint32_t seq;
+    uint8_t payload[FRAME_MAX_PAYLOAD];
+};
+
+// Trama recibida (es grande para la pila de la tarea)
+static struct frame rx_frame;
+/* Resultado de la última transferencia y secuencia con la que se contestó. Si se pierde la respuesta el
+emisor reenvía END, que ya llega fuera de la transferencia: se le contesta otra vez con lo mismo*/
+static bool last_result_valid = false;
+static esp_err_t last_result;
+static uint32_t last_result_seq;
+#if CONFIG_STATIC_ALLOCATION
+// Memoria de la tarea, reservada en tiempo de enlazado
+static StackType_t ota_uart_task_stack[OTA_UART_TASK_STACK_SIZE];
+static StaticTask_t ota_uart_task_buffer;
+#endif
+
+// Tarea que espera transferencias por la UART
+static void ota_uart_task(void * args);
+// Lee exactamente "len" bytes; false si vence el timeout
+static bool read_exact(uint8_t * buf, size_t len, TickType_t timeout);
+// Lee la siguiente trama (ESP_ERR_TIMEOUT si no llega, ESP_ERR_INVALID_CRC si llega corrupta)
+static esp_err_t read_frame(struct frame * frame, TickType_t timeout);
+// Envía una trama
+static void send_frame(uint8_t type, uint32_t seq, const void * payload, uint16_t len);
+// Contesta con el resultado de una transferencia (ACK si "err" es ESP_OK, NAK si no) y espera a que salga
+static void send_result(esp_err_t err, uint32_t seq);
+// Lee de una trama START el tamaño de la imagen (u32) y el de los trozos de datos (u16)
+static bool parse_start(const struct frame * start, uint32_t * image_size, uint16_t * chunk);
+// Recibe la imagen anunciada por la trama START y la escribe en la partición OTA pasiva
+static esp_err_t receive_image(const struct frame * start);
+
+
+static bool read_exact(uint8_t * buf, size_t len, TickType_t timeout){
+    size_t done = 0;
+    while (done < len) {
+        int read = uart_read_bytes(OTA_UART_NUM, buf + done, len - done, timeout);
+        if (read <= 0) return false;
+        done += read;
+    }
+    return true;
+}
+
+static esp_err_t read_frame(struct frame * frame, TickType_t timeout){
+    uint8_t header[FRAME_HEADER_SIZE];
+    // Buscamos el inicio de trama (tras un error descartamos bytes hasta resincronizar)
+    do {
+        if (!read_exact(header, 1, timeout)) return ESP_ERR_TIMEOUT;
+    } while (header[0] != FRAME_SOF);
+    if (!read_exact(header + 1, FRAME_HEADER_SIZE - 1, timeout)) return ESP_ERR_TIMEOUT;
+    frame->type = header[1];
+    memcpy(&frame->len, header + 2, sizeof(frame->len));
+    memcpy(&frame->seq, header + 4, sizeof(frame->seq));
+    if (frame->len > FRAME_MAX_PAYLOAD) return ESP_ERR_INVALID_CRC;
+    uint32_t crc;
+    if (!read_exact(frame->payload, frame->len, timeout)) return ESP_ERR_TIMEOUT;
+    if (!read_exact((uint8_t *) &crc, FRAME_CRC_SIZE, timeout)) return ESP_ERR_TIMEOUT;
+    uint32_t computed = esp_rom_crc32_le(0, header + 1, FRAME_HEADER_SIZE - 1);
+    computed = esp_rom_crc32_le(computed, frame->payload, frame->len);
+    return computed == crc ? ESP_OK : ESP_ERR_INVALID_CRC;
+}
+
+static void send_frame(uint8_t type, uint32_t seq, const void * payload, uint16_t len){
+    uint8_t header[FRAME_HEADER_SIZE] = { FRAME_SOF, type };
+    memcpy(header + 2, &len, sizeof(len));
+    memcpy(header + 4, &seq, sizeof(seq));
+    uint32_t crc = esp_rom_crc32_le(0, header + 1, FRAME_HEADER_SIZE - 1);
+    crc = esp_rom_crc32_le(crc, payload, len);
+    uart_write_bytes(OTA_UART_NUM, header, FRAME_HEADER_SIZE);
+    if (len > 0) uart_write_bytes(OTA_UART_NUM, payload, len);
+    uart_write_bytes(OTA_UART_NUM, &crc, FRAME_CRC_SIZE);
+}
+
+static void send_result(esp_err_t err, uint32_t seq){
+    int32_t result = err;
+    send_frame(err == ESP_OK ? FRAME_ACK : FRAME_NAK, seq, &result, sizeof(result));
+    uart_wait_tx_done(OTA_UART_NUM, pdMS_TO_TICKS(100));
+}
+
+static bool parse_start(const struct frame * start, uint32_t * image_size, uint16_t * chunk){
+    if (start->len < sizeof(*image_size) + sizeof(*chunk)) return false;
+    memcpy(image_size, start->payload, sizeof(*image_size));
+    memcpy(chunk, start->payload + sizeof(*image_size), sizeof(*chunk));
+    return true;
+}
+
+static esp_err_t receive_image(const struct frame * start){
+    // La trama START lleva el tamaño de la imagen y el tamaño de los trozos de datos
+    uint32_t image_size;
+    uint16_t chunk;
+    if (!parse_start(start, &image_size, &chunk)) return ESP_ERR_INVALID_ARG;
+    const esp_partition_t * partition = esp_ota_get_next_update_partition(NULL);
+    // Los trozos deben caber enteros en un sector para ir llenando los buffers del escritor
+    if (partition == NULL || image_size == 0 || image_size > partition->size
+        || chunk == 0 || SPI_FLASH_SEC_SIZE % chunk != 0) {
+        ESP_LOGE(TAG, "Rejected transfer of %u bytes in chunks of %u", image_size, chunk);
+        send_result(ESP_ERR_INVALID_ARG, 0);
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct ota_image_hash * hash = calloc(1, sizeof(struct ota_image_hash));
+    if (hash == NULL) return ESP_ERR_NO_MEM;
+    ota_image_hash_reset(hash, image_size);
+    ota_writer_handle_t writer = ota_writer_start(partition, 0, image_size, hash, NULL, NULL);
+    if (writer == NULL) {
+        free(hash);
+        return ESP_ERR_NO_MEM;
+    }
+    // Respondemos con la ventana máxima: las tramas en vuelo deben caber en el buffer de recepción
+    uint16_t window = OTA_UART_RX_BUF_SIZE / (chunk + FRAME_HEADER_SIZE + FRAME_CRC_SIZE);
+    send_frame(FRAME_ACK, 0, &window, sizeof(window));
+    ESP_LOGI(TAG, "Receiving %u bytes into partition %s (window %u)", image_size, partition->label, window);
+    esp_event_post(OTA_EVENT, OTA_EVENT_STARTED, NULL, 0, 0);
+
+    uint32_t total_frames = (image_size + chunk - 1) / chunk;
+    uint32_t expected = 0;
+    uint32_t received = 0;
+    // Evita repetir el NAK por cada trama en vuelo que llega tras un hueco
+    bool nak_sent = false;
+    int last_step = -1;
+    uint8_t * sector = ota_writer_get_buffer(writer);
+    size_t filled = 0;
+    esp_err_t err = ESP_OK;
+    while (err == ESP_OK) {
+        esp_err_t frame_err = read_frame(&rx_frame, pdMS_TO_TICKS(OTA_UART_TIMEOUT_MS));
+        if (frame_err == ESP_ERR_TIMEOUT) {
+            ESP_LOGE(TAG, "Transfer timed out at %u/%u bytes", received, image_size);
+            err = ESP_ERR_TIMEOUT;
+            break;
+        }
+        // Una trama corrupta se descarta: el hueco en la secuencia provoca el NAK con la siguiente
+        if (frame_err != ESP_OK) continue;
+        if (rx_frame.type == FRAME_DATA) {
+            uint32_t expected_len = expected + 1 < total_frames ? chunk : image_size - expected * chunk;
+            if (rx_frame.seq == expected && rx_frame.len == expected_len) {
+                memcpy(sector + filled, rx_frame.payload, rx_frame.len);
+                filled += rx_frame.len;
+                received += rx_frame.len;
+                expected++;
+                nak_sent = false;
+                // El escritor borra y escribe el sector mientras seguimos recibiendo en otro buffer
+                if (filled == SPI_FLASH_SEC_SIZE || received == image_size) {
+                    err = ota_writer_submit(writer, sector, filled);
+                    sector = ota_writer_get_buffer(writer);
+                    filled = 0;
+                }
+                send_frame(FRAME_ACK, expected, NULL, 0);
+                int step = (int) ((uint64_t) received * 100 / image_size) / PROGRESS_EVENT_STEP;
+                if (step != last_step) {
+                    last_step = step;
+                    struct ota_progress_event event = { .bytes_done = received, .bytes_total = image_size };
+                    esp_event_post(OTA_EVENT, OTA_EVENT_PROGRESS, &event, sizeof(event), 0);
+                }
+            }
+            // Duplicado (se perdió nuestro ACK): confirmamos de nuevo hasta dónde tenemos
+            else if (rx_frame.seq < expected) {
+                send_frame(FRAME_ACK, expected, NULL, 0);
+            }
+            // Hueco en la secuencia: el emisor debe volver a enviar desde "expected" (go-back-N)
+            else if (!nak_sent) {
+                send_frame(FRAME_NAK, expected, NULL, 0);
+                nak_sent = true;
+            }
+        }
+        else if (rx_frame.type == FRAME_END) {
+            if (received != image_size) err = ESP_ERR_INVALID_SIZE;
+            break;
+        }
+        /* START repetido (el emisor lo reenvía si no le llega nuestro ACK): si anuncia la misma imagen
+        confirmamos de nuevo la ventana; si es otra, la transferencia en curso ya no sirve*/
+        else if (rx_frame.type == FRAME_START) {
+            uint32_t again_size;
+            uint16_t again_chunk;
+            if (parse_start(&rx_frame, &again_size, &again_chunk) && again_size == image_size && again_chunk == chunk) {
+                send_frame(FRAME_ACK, 0, &window, sizeof(window));
+            }
+            else {
+                err = ESP_ERR_INVALID_STATE;
+            }
+        }
+        else if (rx_frame.type == FRAME_ABORT) {
+            err = ESP_ERR_INVALID_STATE;
+        }
+    }
+    // Esperamos a que se escriba lo pendiente (el buffer a medio llenar se libera con el escritor)
+    esp_err_t write_err = ota_writer_stop(writer);
+    if (err == ESP_OK) err = write_err;
+    uint8_t digest[OTA_IMAGE_HASH_LEN];
+    esp_err_t hash_err = ota_image_hash_check(hash, digest);
+    free(hash);
+    if (err == ESP_OK && hash_err == ESP_ERR_INVALID_CRC) {
+        ESP_LOGE(TAG, "SHA-256 of received image does not match");
+        err = hash_err;
+    }
+    // La imagen se verifica al fijarla como partición de arranque; en el siguiente arranque pasa por verify_image
+    if (err == ESP_OK) err = esp_ota_set_boot_partition(partition);
+    // Contestamos al END (o al fallo) con el resultado para que el emisor lo muestre
+    last_result = err;
+    last_result_seq = expected;
+    last_result_valid = true;
+    send_result(err, expected);
+    return err;
+}
+
+static void ota_uart_task(void * args){
+    while (1) {
+        /* Fuera de una transferencia atendemos tramas START y los END repetidos de la última (se perdió
+        el resultado); el resto se ignora*/
+        if (read_frame(&rx_frame, portMAX_DELAY) != ESP_OK) continue;
+        if (rx_frame.type == FRAME_END && last_result_valid) {
+            send_result(last_result, last_result_seq);
+            continue;
+        }
+        if (rx_frame.type != FRAME_START) continue;
+        last_result_valid = false;
+        // La descarga HTTP escribe en la misma partición: rechazamos la transferencia mientras dure
+        if (!ota_transfer_lock()) {
+            ESP_LOGW(TAG, "Another firmware transfer is in progress");
+            send_result(ESP_ERR_INVALID_STATE, 0);
+            continue;
+        }
+        /* Vamos a escribir sobre lo que hubiese dejado una descarga HTTP interrumpida: si no olvidamos su
+        progreso, la siguiente descarga continuaría sobre lo escrito por esta transferencia*/
+        clear_ota_progress();
+        esp_err_t err = receive_image(&rx_frame);
+        ota_transfer_unlock();
+        if (err == ESP_OK) {
+            ESP_LOGI(TAG, "Image received, restarting");
+            esp_event_post(OTA_EVENT, OTA_EVENT_FINISHED, NULL, 0, 0);
+            vTaskDelay(pdMS_TO_TICKS(100));
+            esp_restart();
+        }
+        ESP_LOGE(TAG, "UART update failed (%s)", esp_err_to_name(err));
+        esp_event_post(OTA_EVENT, OTA_EVENT_FAILED, &err, sizeof(err), 0);
+    }
+}
+
+void ota_uart_start(){
+    uart_config_t uart_config = {
+        .baud_rate = OTA_UART_BAUD,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .source_clk = UART_SCLK_APB,
+    };
+    ESP_ERROR_CHECK(uart_driver_install(OTA_UART_NUM, OTA_UART_RX_BUF_SIZE, 0, 0, NULL, 0));
+    ESP_ERROR_CHECK(uart_param_config(OTA_UART_NUM, &uart_config));
+    ESP_ERROR_CHECK(uart_set_pin(OTA_UART_NUM, OTA_UART_TX_IO, OTA_UART_RX_IO, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+#if CONFIG_STATIC_ALLOCATION
+    task_plan_create_static(TASK_PLAN_OTA_UART, ota_uart_task, "OTA UART task", OTA_UART_TASK_STACK_SIZE, NULL,
+                            ota_uart_task_stack, &ota_uart_task_buffer);
+#else
+    task_plan_create(TASK_PLAN_OTA_UART, ota_uart_task, "OTA UART task", OTA_UART_TASK_STACK_SIZE, NULL, NULL);
+#endif
+}
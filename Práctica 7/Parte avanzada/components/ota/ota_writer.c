@@ -0,0 +1,237 @@
+#include <string.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include "ota_writer.h"
+#include "task_signal.h"
+#include "task_plan.h"
+#include "diagnostics.h"
+
+// Número de buffers de un sector entre la descarga y la escritura en flash
+#define OTA_WRITER_BUFFERS CONFIG_OTA_WRITER_BUFFERS
+// Posición del campo hash_appended en la cabecera de la imagen (esp_image_header_t)
+#define IMAGE_HEADER_HASH_APPENDED_OFFSET 23
+/* Posición de app_elf_sha256 dentro de la imagen: cabecera de imagen (24) + cabecera del primer
+segmento (8) + campos de esp_app_desc_t anteriores (144)*/
+#define IMAGE_APP_ELF_SHA_OFFSET (24 + 8 + 144)
+
+static const char *TAG = "OTA writer";
+
+// Elemento de la cola hacia el escritor (un buffer nulo indica el final)
+struct writer_item {
+    uint8_t * buf;
+    size_t len;
+};
+
+struct ota_writer {
+    const esp_partition_t * partition;
+    // Offset inicial, siguiente byte a escribir y hasta dónde está ya borrada la partición
+    uint32_t start_offset;
+    uint32_t written;
+    uint32_t erased_until;
+    // Final de la zona a borrar (tamaño de imagen redondeado a sector)
+    uint32_t erase_end;
+    struct ota_image_hash * hash;
+    ota_writer_cb_t written_cb;
+    void * cb_arg;
+    uint8_t * buffers[OTA_WRITER_BUFFERS];
+    QueueHandle_t free_buffers;
+    QueueHandle_t full_buffers;
+    // Tarea que espera en ota_writer_stop a que el escritor termine (se le avisa con SIGNAL_OTA_WRITER_DONE)
+    TaskHandle_t waiter;
+    esp_err_t err;
+    // Tiempos acumulados de cada etapa para el informe de rendimiento
+    int64_t start_time;
+    int64_t download_us;
+    int64_t erase_us;
+    int64_t write_us;
+    int64_t hash_us;
+};
+
+// Tarea que escribe en flash los buffers que le entrega la descarga
+static void writer_task(void * args);
+// Borra el siguiente sector aún no borrado
+static esp_err_t erase_next_sector(ota_writer_handle_t writer);
+// Borra lo que haga falta y escribe un buffer en la posición actual
+static esp_err_t write_buffer(ota_writer_handle_t writer, const uint8_t * buf, size_t len);
+// Añade al hash los bytes escritos en "offset"
+static void image_hash_update(struct ota_image_hash * hash, uint32_t offset, const uint8_t * buf, size_t len);
+
+
+void ota_image_hash_reset(struct ota_image_hash * hash, uint32_t image_size){
+    mbedtls_sha256_free(&hash->ctx);
+    mbedtls_sha256_init(&hash->ctx);
+    mbedtls_sha256_starts_ret(&hash->ctx, 0);
+    hash->image_size = image_size;
+    hash->hashed = 0;
+    hash->hash_appended = false;
+    hash->valid = image_size > OTA_IMAGE_HASH_LEN;
+}
+
+static void image_hash_update(struct ota_image_hash * hash, uint32_t offset, const uint8_t * buf, size_t len){
+    if (!hash->valid) return;
+    // Si los datos no continúan justo donde se quedó el hash (reanudación tras reinicio) ya no sirve
+    if (offset != hash->hashed) {
+        hash->valid = false;
+        return;
+    }
+    if (offset == 0 && len >= IMAGE_APP_ELF_SHA_OFFSET + OTA_IMAGE_HASH_LEN) {
+        hash->hash_appended = buf[IMAGE_HEADER_HASH_APPENDED_OFFSET] == 1;
+        memcpy(hash->elf_sha, buf + IMAGE_APP_ELF_SHA_OFFSET, OTA_IMAGE_HASH_LEN);
+    }
+    // Todo salvo los últimos 32 bytes entra en el hash; esos 32 bytes son el SHA-256 con el que comparar
+    uint32_t hash_end = hash->image_size - OTA_IMAGE_HASH_LEN;
+    size_t hashed_len = 0;
+    if (offset < hash_end) {
+        hashed_len = hash_end - offset < len ? hash_end - offset : len;
+        mbedtls_sha256_update_ret(&hash->ctx, buf, hashed_len);
+    }
+    if (hashed_len < len) {
+        memcpy(hash->appended + (offset + hashed_len - hash_end), buf + hashed_len, len - hashed_len);
+    }
+    hash->hashed += len;
+}
+
+esp_err_t ota_image_hash_check(struct ota_image_hash * hash, uint8_t * digest){
+    if (!hash->valid || hash->hashed != hash->image_size || !hash->hash_appended) {
+        mbedtls_sha256_free(&hash->ctx);
+        return ESP_ERR_INVALID_STATE;
+    }
+    mbedtls_sha256_finish_ret(&hash->ctx, digest);
+    mbedtls_sha256_free(&hash->ctx);
+    hash->valid = false;
+    return memcmp(digest, hash->appended, OTA_IMAGE_HASH_LEN) == 0 ? ESP_OK : ESP_ERR_INVALID_CRC;
+}
+
+static esp_err_t erase_next_sector(ota_writer_handle_t writer){
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = esp_partition_erase_range(writer->partition, writer->erased_until, SPI_FLASH_SEC_SIZE);
+    writer->erase_us += esp_timer_get_time() - start;
+    if (err == ESP_OK) writer->erased_until += SPI_FLASH_SEC_SIZE;
+    return err;
+}
+
+static esp_err_t write_buffer(ota_writer_handle_t writer, const uint8_t * buf, size_t len){
+    // Normalmente ya estará borrado por adelantado; si la descarga va más rápida que el borrado, borramos ahora
+    while (writer->erased_until < writer->written + len) {
+        esp_err_t err = erase_next_sector(writer);
+        if (err != ESP_OK) return err;
+    }
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = esp_partition_write(writer->partition, writer->written, buf, len);
+    writer->write_us += esp_timer_get_time() - start;
+    if (err != ESP_OK) return err;
+    // El hash se calcula sobre el buffer ya en RAM, así no hay que releer la flash al terminar
+    start = esp_timer_get_time();
+    image_hash_update(writer->hash, writer->written, buf, len);
+    writer->hash_us += esp_timer_get_time() - start;
+    writer->written += len;
+    if (writer->written_cb != NULL) writer->written_cb(writer->written, writer->cb_arg);
+    return ESP_OK;
+}
+
+static void writer_task(void * args){
+    ota_writer_handle_t writer = (ota_writer_handle_t) args;
+    struct writer_item item;
+    while (1) {
+        if (xQueueReceive(writer->full_buffers, &item, 0) != pdTRUE) {
+            // Sin datos pendientes: aprovechamos para borrar el siguiente sector mientras la descarga sigue
+            if (writer->err == ESP_OK && writer->erased_until < writer->erase_end) {
+                writer->err = erase_next_sector(writer);
+                continue;
+            }
+            while (xQueueReceive(writer->full_buffers, &item, portMAX_DELAY) != pdTRUE);
+        }
+        if (item.buf == NULL) break;
+        // Tras un error seguimos devolviendo buffers (sin escribir) para que la descarga no se bloquee
+        if (writer->err == ESP_OK) writer->err = write_buffer(writer, item.buf, item.len);
+        xQueueSendToBack(writer->free_buffers, &item.buf, portMAX_DELAY);
+    }
+    // Anotamos el margen de pila antes de avisar: después quien espera libera "writer"
+    diagnostics_task_exit();
+    task_signal_send(writer->waiter, SIGNAL_OTA_WRITER_DONE);
+    vTaskDelete(NULL);
+}
+
+ota_writer_handle_t ota_writer_start(const esp_partition_t * partition, uint32_t offset, uint32_t image_size,
+                                     struct ota_image_hash * hash, ota_writer_cb_t written_cb, void * cb_arg){
+    ota_writer_handle_t writer = calloc(1, sizeof(struct ota_writer));
+    if (writer == NULL) return NULL;
+    writer->partition = partition;
+    writer->start_offset = offset;
+    writer->written = offset;
+    writer->erased_until = offset;
+    writer->erase_end = (image_size + SPI_FLASH_SEC_SIZE - 1) / SPI_FLASH_SEC_SIZE * SPI_FLASH_SEC_SIZE;
+    writer->hash = hash;
+    writer->written_cb = written_cb;
+    writer->cb_arg = cb_arg;
+    writer->free_buffers = xQueueCreate(OTA_WRITER_BUFFERS, sizeof(uint8_t *));
+    writer->full_buffers = xQueueCreate(OTA_WRITER_BUFFERS + 1, sizeof(struct writer_item));
+    bool ok = writer->free_buffers != NULL && writer->full_buffers != NULL;
+    for (int i = 0; ok && i < OTA_WRITER_BUFFERS; i++) {
+        writer->buffers[i] = malloc(SPI_FLASH_SEC_SIZE);
+        ok = writer->buffers[i] != NULL;
+        if (ok) xQueueSendToBack(writer->free_buffers, &writer->buffers[i], 0);
+    }
+    writer->start_time = esp_timer_get_time();
+    if (ok) ok = task_plan_create(TASK_PLAN_OTA_WRITER, writer_task, "OTA writer", 3072, writer, NULL) == pdPASS;
+    if (!ok) {
+        ESP_LOGE(TAG, "Can't allocate OTA writer");
+        for (int i = 0; i < OTA_WRITER_BUFFERS; i++) free(writer->buffers[i]);
+        if (writer->free_buffers != NULL) vQueueDelete(writer->free_buffers);
+        if (writer->full_buffers != NULL) vQueueDelete(writer->full_buffers);
+        free(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+uint8_t * ota_writer_get_buffer(ota_writer_handle_t writer){
+    uint8_t * buf;
+    while (xQueueReceive(writer->free_buffers, &buf, portMAX_DELAY) != pdTRUE);
+    return buf;
+}
+
+esp_err_t ota_writer_submit(ota_writer_handle_t writer, uint8_t * buf, size_t len){
+    // Si el escritor ya ha fallado no tiene sentido seguir descargando
+    if (writer->err != ESP_OK) {
+        xQueueSendToBack(writer->free_buffers, &buf, 0);
+        return writer->err;
+    }
+    struct writer_item item = { .buf = buf, .len = len };
+    xQueueSendToBack(writer->full_buffers, &item, portMAX_DELAY);
+    return ESP_OK;
+}
+
+void ota_writer_add_download_time(ota_writer_handle_t writer, int64_t us){
+    writer->download_us += us;
+}
+
+esp_err_t ota_writer_stop(ota_writer_handle_t writer){
+    // Buffer nulo para que la tarea termine tras escribir los pendientes (y nos avise a nosotros)
+    writer->waiter = xTaskGetCurrentTaskHandle();
+    struct writer_item end = { .buf = NULL, .len = 0 };
+    xQueueSendToBack(writer->full_buffers, &end, portMAX_DELAY);
+    while (task_signal_wait(SIGNAL_OTA_WRITER_DONE, portMAX_DELAY) == 0);
+    esp_err_t err = writer->err;
+
+    // Informe de rendimiento por etapa (KB/s de cada etapa respecto al tiempo que ha ocupado)
+    uint32_t bytes = writer->written - writer->start_offset;
+    uint32_t erased = writer->erased_until - writer->start_offset;
+    int64_t elapsed_us = esp_timer_get_time() - writer->start_time;
+    ESP_LOGI(TAG, "%u bytes in %lld ms (%lld KB/s overall)", bytes, elapsed_us / 1000,
+             elapsed_us > 0 ? (int64_t) bytes * 1000000 / 1024 / elapsed_us : 0);
+    ESP_LOGI(TAG, "download %lld ms (%lld KB/s), erase %lld ms (%lld KB/s), write %lld ms (%lld KB/s), hash %lld ms",
+             writer->download_us / 1000, writer->download_us > 0 ? (int64_t) bytes * 1000000 / 1024 / writer->download_us : 0,
+             writer->erase_us / 1000, writer->erase_us > 0 ? (int64_t) erased * 1000000 / 1024 / writer->erase_us : 0,
+             writer->write_us / 1000, writer->write_us > 0 ? (int64_t) bytes * 1000000 / 1024 / writer->write_us : 0,
+             writer->hash_us / 1000);
+
+    for (int i = 0; i < OTA_WRITER_BUFFERS; i++) free(writer->buffers[i]);
+    vQueueDelete(writer->free_buffers);
+    vQueueDelete(writer->full_buffers);
+    free(writer);
+    return err;
+}
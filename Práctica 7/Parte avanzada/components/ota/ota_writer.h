@@ -0,0 +1,53 @@
+#ifndef OTA_WRITER_H
+#define OTA_WRITER_H
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+#include "mbedtls/sha256.h"
+
+// Longitud del SHA-256 que el build añade al final de la imagen
+#define OTA_IMAGE_HASH_LEN 32
+
+/* SHA-256 de la imagen calculado a medida que se escribe. Vive fuera del escritor para que se conserve
+entre reconexiones de una misma actualización (tras un reinicio se pierde y se marca como no válido).*/
+struct ota_image_hash {
+    mbedtls_sha256_context ctx;
+    uint32_t image_size;
+    // Bytes de la imagen ya incluidos en el hash
+    uint32_t hashed;
+    bool valid;
+    // Indica si la cabecera de la imagen anuncia el SHA-256 añadido al final
+    bool hash_appended;
+    // Últimos bytes de la imagen: el SHA-256 añadido por el build, que no entra en el hash
+    uint8_t appended[OTA_IMAGE_HASH_LEN];
+    // SHA-256 del ELF copiado de la descripción de la aplicación que va en la cabecera de la imagen
+    uint8_t elf_sha[OTA_IMAGE_HASH_LEN];
+};
+
+// Escritor OTA (tarea que borra y escribe en flash en paralelo con la descarga)
+typedef struct ota_writer * ota_writer_handle_t;
+// Callback que se llama desde la tarea del escritor cada vez que un sector queda escrito en flash
+typedef void (*ota_writer_cb_t)(uint32_t bytes_written, void * arg);
+
+// Reinicia el hash para una imagen nueva de "image_size" bytes
+void ota_image_hash_reset(struct ota_image_hash * hash, uint32_t image_size);
+/* Comprueba el hash calculado con el SHA-256 añadido al final de la imagen y lo devuelve en "digest".
+Devuelve ESP_ERR_INVALID_STATE si no se pudo calcular (descarga reanudada tras un reinicio)*/
+esp_err_t ota_image_hash_check(struct ota_image_hash * hash, uint8_t * digest);
+
+/* Arranca la tarea escritora para escribir la imagen de "image_size" bytes en "partition" a partir de "offset"
+(múltiplo del tamaño de sector). Mientras espera datos va borrando por adelantado los siguientes sectores.*/
+ota_writer_handle_t ota_writer_start(const esp_partition_t * partition, uint32_t offset, uint32_t image_size,
+                                     struct ota_image_hash * hash, ota_writer_cb_t written_cb, void * cb_arg);
+// Devuelve un buffer libre de un sector (espera a que el escritor libere uno si están todos ocupados)
+uint8_t * ota_writer_get_buffer(ota_writer_handle_t writer);
+// Entrega al escritor un buffer con "len" bytes (un sector completo o el último trozo de la imagen)
+esp_err_t ota_writer_submit(ota_writer_handle_t writer, uint8_t * buf, size_t len);
+// Suma "us" microsegundos al tiempo de descarga que se muestra en el informe final
+void ota_writer_add_download_time(ota_writer_handle_t writer, int64_t us);
+/* Espera a que se escriban los buffers pendientes, muestra el rendimiento de cada etapa, para la tarea
+y libera el escritor. Devuelve el primer error de escritura que se haya producido.*/
+esp_err_t ota_writer_stop(ota_writer_handle_t writer);
+#endif
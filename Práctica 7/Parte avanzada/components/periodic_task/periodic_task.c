@@ -0,0 +1,184 @@
+#include <stdlib.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "periodic_task.h"
+
+// Cada cuántas ejecuciones se muestran las estadísticas (0 para no mostrarlas)
+#define PERIODIC_TASK_REPORT_RUNS CONFIG_PERIODIC_TASK_REPORT_RUNS
+#if CONFIG_PERIODIC_TASK_STATIC
+// Tareas que caben en la reserva estática y pila de cada una
+#define PERIODIC_TASK_STATIC_MAX CONFIG_PERIODIC_TASK_STATIC_MAX
+#define PERIODIC_TASK_STATIC_STACK_SIZE CONFIG_PERIODIC_TASK_STATIC_STACK_SIZE
+#endif
+
+static const char* TAG = "Periodic task";
+
+struct periodic_task {
+    const char * name;
+    periodic_task_fn func;
+    void * arg;
+    TickType_t period;
+    enum periodic_task_policy policy;
+    TaskHandle_t handle;
+    // Protege las estadísticas (las leen y reinician otras tareas)
+    portMUX_TYPE lock;
+    struct periodic_task_stats stats;
+#if CONFIG_PERIODIC_TASK_STATIC
+    // Memoria de la tarea y si la entrada de la reserva está en uso
+    StaticTask_t buffer;
+    StackType_t stack[PERIODIC_TASK_STATIC_STACK_SIZE];
+    bool used;
+#endif
+};
+
+#if CONFIG_PERIODIC_TASK_STATIC
+// Reserva de tareas en tiempo de enlazado (protegida por pool_lock)
+static struct periodic_task pool[PERIODIC_TASK_STATIC_MAX];
+static portMUX_TYPE pool_lock = portMUX_INITIALIZER_UNLOCKED;
+#endif
+
+// Cuerpo de la tarea: espera a cada instante absoluto y ejecuta la función
+static void periodic_task_loop(void * params);
+// Reserva la memoria de una tarea (del heap o de la reserva estática). Devuelve NULL si no queda
+static struct periodic_task * task_alloc();
+// Libera la memoria de una tarea
+static void task_free(struct periodic_task * task);
+
+
+static void periodic_task_loop(void * params){
+    struct periodic_task * task = (struct periodic_task *) params;
+    /* Instante previsto de la ejecución, en ticks (el que avanza vTaskDelayUntil) y en us (para medir el retraso).
+    Partimos del comienzo de un tick para que ambos relojes estén alineados.*/
+    TickType_t last_wake = xTaskGetTickCount();
+    vTaskDelayUntil(&last_wake, 1);
+    int64_t deadline_us = esp_timer_get_time();
+    const int64_t period_us = (int64_t) task->period * portTICK_PERIOD_MS * 1000;
+    while(1){
+        // Si el instante ya ha pasado no se bloquea y vuelve enseguida (así se recuperan los instantes perdidos)
+        vTaskDelayUntil(&last_wake, task->period);
+        deadline_us += period_us;
+        int64_t lateness = esp_timer_get_time() - deadline_us;
+        if (lateness < 0) lateness = 0;
+        // Instantes que ya han pasado mientras esperábamos a este
+        uint32_t missed = lateness / period_us;
+        if (missed > 0 && task->policy == PERIODIC_TASK_SKIP) {
+            /* Saltamos los instantes que ya han pasado: esta ejecución cuenta para el último de ellos y la
+            siguiente será en el siguiente instante del periodo, sin perder la fase*/
+            last_wake += missed * task->period;
+            deadline_us += missed * period_us;
+            lateness -= missed * period_us;
+        }
+        else if (missed > 0) {
+            // Al recuperar cada instante se ejecuta tarde una vez: cuenta solo este (los demás contarán al ejecutarse)
+            missed = 1;
+        }
+        portENTER_CRITICAL(&task->lock);
+        task->stats.runs++;
+        task->stats.missed += missed;
+        task->stats.total_lateness_us += lateness;
+        if (lateness > task->stats.max_lateness_us) task->stats.max_lateness_us = lateness;
+        uint32_t runs = task->stats.runs;
+        portEXIT_CRITICAL(&task->lock);
+        task->func(task->arg);
+        if (PERIODIC_TASK_REPORT_RUNS > 0 && runs % PERIODIC_TASK_REPORT_RUNS == 0) periodic_task_show_stats(task);
+    }
+    vTaskDelete(NULL);
+}
+
+static struct periodic_task * task_alloc(){
+#if CONFIG_PERIODIC_TASK_STATIC
+    struct periodic_task * task = NULL;
+    portENTER_CRITICAL(&pool_lock);
+    for (int i = 0; i < PERIODIC_TASK_STATIC_MAX && task == NULL; i++){
+        if (!pool[i].used) {
+            task = &pool[i];
+            task->used = true;
+        }
+    }
+    portEXIT_CRITICAL(&pool_lock);
+    if (task != NULL) task->stats = (struct periodic_task_stats) {0};
+    return task;
+#else
+    return calloc(1, sizeof(struct periodic_task));
+#endif
+}
+
+static void task_free(struct periodic_task * task){
+#if CONFIG_PERIODIC_TASK_STATIC
+    portENTER_CRITICAL(&pool_lock);
+    task->used = false;
+    portEXIT_CRITICAL(&pool_lock);
+#else
+    free(task);
+#endif
+}
+
+struct periodic_task * periodic_task_create(const char * name, periodic_task_fn func, void * arg, uint32_t period_ms,
+                                            enum periodic_task_policy policy, uint32_t stack_size, UBaseType_t priority,
+                                            BaseType_t core_id){
+#if CONFIG_PERIODIC_TASK_STATIC
+    if (stack_size > PERIODIC_TASK_STATIC_STACK_SIZE) {
+        ESP_LOGE(TAG, "Task %s asks for %u bytes of stack, the pool has %u", name, stack_size,
+                 PERIODIC_TASK_STATIC_STACK_SIZE);
+        return NULL;
+    }
+#endif
+    struct periodic_task * task = task_alloc();
+    if (task == NULL) {
+        ESP_LOGE(TAG, "No memory for task %s", name);
+        return NULL;
+    }
+    task->name = name;
+    task->func = func;
+    task->arg = arg;
+    task->period = pdMS_TO_TICKS(period_ms) > 0 ? pdMS_TO_TICKS(period_ms) : 1;
+    task->policy = policy;
+    portMUX_INITIALIZE(&task->lock);
+#if CONFIG_PERIODIC_TASK_STATIC
+    // Usa la pila que se pide (el resto de la de la entrada queda sin usar)
+    task->handle = xTaskCreateStaticPinnedToCore(periodic_task_loop, name, stack_size, task, priority, task->stack,
+                                                 &task->buffer, core_id);
+    if (task->handle == NULL) {
+        ESP_LOGE(TAG, "Could not create task %s", name);
+        task_free(task);
+        return NULL;
+    }
+#else
+    if (xTaskCreatePinnedToCore(periodic_task_loop, name, stack_size, task, priority, &task->handle, core_id) != pdPASS) {
+        ESP_LOGE(TAG, "Could not create task %s", name);
+        task_free(task);
+        return NULL;
+    }
+#endif
+    return task;
+}
+
+void periodic_task_delete(struct periodic_task * task){
+    vTaskDelete(task->handle);
+    task_free(task);
+}
+
+TaskHandle_t periodic_task_get_handle(struct periodic_task * task){
+    return task->handle;
+}
+
+void periodic_task_get_stats(struct periodic_task * task, struct periodic_task_stats * stats){
+    portENTER_CRITICAL(&task->lock);
+    *stats = task->stats;
+    portEXIT_CRITICAL(&task->lock);
+}
+
+void periodic_task_reset_stats(struct periodic_task * task){
+    portENTER_CRITICAL(&task->lock);
+    task->stats = (struct periodic_task_stats) {0};
+    portEXIT_CRITICAL(&task->lock);
+}
+
+void periodic_task_show_stats(struct periodic_task * task){
+    struct periodic_task_stats stats;
+    periodic_task_get_stats(task, &stats);
+    ESP_LOGI(TAG, "%s: %u runs, %u missed, lateness mean %lld us max %lld us", task->name, stats.runs, stats.missed,
+             stats.runs > 0 ? stats.total_lateness_us / stats.runs : 0, stats.max_lateness_us);
+}
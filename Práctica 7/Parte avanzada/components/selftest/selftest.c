@@ -0,0 +1,123 @@
+#include <string.h>
+#include <esp_log.h>
+#include <esp_ota_ops.h>
+#include <nvs.h>
+#include "selftest.h"
+
+// Máximo número de micro-benchmarks registrados
+#define SELFTEST_MAX_BENCHES 8
+// Regresión permitida respecto al presupuesto de la imagen anterior
+#define SELFTEST_TOLERANCE_PCT CONFIG_SELFTEST_TOLERANCE_PCT
+// Espacio de nombres de la NVS con los presupuestos (una clave por micro-benchmark)
+#define SELFTEST_NAMESPACE "selftest"
+// Clave con la versión de la imagen que guardó los presupuestos
+#define SELFTEST_VERSION_KEY "version"
+
+static const char *TAG = "Self-test";
+
+struct selftest_bench {
+    const char * name;
+    const char * unit;
+    selftest_bench_t bench;
+    enum selftest_direction direction;
+    uint32_t slack;
+};
+
+static struct selftest_bench benches[SELFTEST_MAX_BENCHES];
+static int num_benches = 0;
+
+// Ejecuta todos los micro-benchmarks dejando las medidas en "values"
+static bool measure_all(uint32_t * values);
+// Guarda las medidas como presupuesto para la siguiente imagen
+static void save_budgets(const uint32_t * values);
+// Indica si "value" empeora el presupuesto más de lo permitido
+static bool is_regression(const struct selftest_bench * bench, uint32_t value, uint32_t budget);
+
+
+void selftest_register(const char * name, const char * unit, selftest_bench_t bench,
+                       enum selftest_direction direction, uint32_t slack){
+    if (num_benches >= SELFTEST_MAX_BENCHES || strlen(name) >= NVS_KEY_NAME_MAX_SIZE) {
+        ESP_LOGE(TAG, "Can't register benchmark %s", name);
+        return;
+    }
+    benches[num_benches++] = (struct selftest_bench) {
+        .name = name, .unit = unit, .bench = bench, .direction = direction, .slack = slack
+    };
+}
+
+static bool measure_all(uint32_t * values){
+    for (int i = 0; i < num_benches; i++) {
+        if (!benches[i].bench(&values[i])) {
+            ESP_LOGE(TAG, "Benchmark %s failed", benches[i].name);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void save_budgets(const uint32_t * values){
+    nvs_handle_t nvs_handle;
+    if (nvs_open(SELFTEST_NAMESPACE, NVS_READWRITE, &nvs_handle) != ESP_OK) return;
+    for (int i = 0; i < num_benches; i++) {
+        ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_set_u32(nvs_handle, benches[i].name, values[i]));
+    }
+    ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_set_str(nvs_handle, SELFTEST_VERSION_KEY, esp_ota_get_app_description()->version));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_commit(nvs_handle));
+    nvs_close(nvs_handle);
+}
+
+static bool is_regression(const struct selftest_bench * bench, uint32_t value, uint32_t budget){
+    uint64_t margin = (uint64_t) budget * SELFTEST_TOLERANCE_PCT / 100 + bench->slack;
+    if (bench->direction == SELFTEST_LOWER_IS_BETTER) return value > budget + margin;
+    return (uint64_t) value + margin < budget;
+}
+
+bool selftest_run(){
+    uint32_t values[SELFTEST_MAX_BENCHES];
+    if (!measure_all(values)) return false;
+    nvs_handle_t nvs_handle;
+    bool has_budgets = nvs_open(SELFTEST_NAMESPACE, NVS_READONLY, &nvs_handle) == ESP_OK;
+    if (has_budgets) {
+        char version[sizeof(esp_ota_get_app_description()->version)];
+        size_t len = sizeof(version);
+        if (nvs_get_str(nvs_handle, SELFTEST_VERSION_KEY, version, &len) == ESP_OK) {
+            ESP_LOGI(TAG, "Budgets recorded by version %s", version);
+        }
+    }
+    bool passed = true;
+    for (int i = 0; i < num_benches; i++) {
+        uint32_t budget;
+        // Un micro-benchmark nuevo (sin presupuesto) no puede suponer una regresión
+        if (!has_budgets || nvs_get_u32(nvs_handle, benches[i].name, &budget) != ESP_OK) {
+            ESP_LOGI(TAG, "%s: %u %s (no budget)", benches[i].name, values[i], benches[i].unit);
+            continue;
+        }
+        bool regression = is_regression(&benches[i], values[i], budget);
+        if (regression) passed = false;
+        ESP_LOGI(TAG, "%s: %u %s (budget %u %s)%s", benches[i].name, values[i], benches[i].unit,
+                 budget, benches[i].unit, regression ? " REGRESSION" : "");
+    }
+    if (has_budgets) nvs_close(nvs_handle);
+    // Solo una imagen que pasa el test fija los presupuestos con los que se medirá la siguiente
+    if (passed) save_budgets(values);
+    return passed;
+}
+
+void selftest_record_baseline(){
+    nvs_handle_t nvs_handle;
+    bool complete = false;
+    if (nvs_open(SELFTEST_NAMESPACE, NVS_READONLY, &nvs_handle) == ESP_OK) {
+        complete = true;
+        for (int i = 0; complete && i < num_benches; i++) {
+            uint32_t budget;
+            complete = nvs_get_u32(nvs_handle, benches[i].name, &budget) == ESP_OK;
+        }
+        nvs_close(nvs_handle);
+    }
+    if (complete) return;
+    uint32_t values[SELFTEST_MAX_BENCHES];
+    if (measure_all(values)) {
+        ESP_LOGI(TAG, "Recording baseline budgets");
+        save_budgets(values);
+    }
+}
@@ -0,0 +1,23 @@
+#ifndef SELFTEST_H
+#define SELFTEST_H
+#include <stdbool.h>
+#include <stdint.h>
+// Número de repeticiones de cada micro-benchmark
+#define SELFTEST_SAMPLES CONFIG_SELFTEST_SAMPLES
+// Micro-benchmark: deja su medida en "value" y devuelve false si no se ha podido medir
+typedef bool (*selftest_bench_t)(uint32_t * value);
+// Sentido de una métrica (si un valor mayor es una mejora o un empeoramiento)
+enum selftest_direction {
+    SELFTEST_LOWER_IS_BETTER,
+    SELFTEST_HIGHER_IS_BETTER
+};
+/* Registra un micro-benchmark. El nombre (máximo 15 caracteres) es también su clave en NVS y
+"slack" es un margen absoluto que se suma a la tolerancia (para métricas que pueden valer 0)*/
+void selftest_register(const char * name, const char * unit, selftest_bench_t bench,
+                       enum selftest_direction direction, uint32_t slack);
+/* Ejecuta todos los micro-benchmarks y los compara con los presupuestos guardados por la imagen
+anterior. Si no hay regresión guarda las nuevas medidas como presupuesto y devuelve true.*/
+bool selftest_run();
+// Si falta algún presupuesto (primera imagen instalada) ejecuta los micro-benchmarks y los guarda
+void selftest_record_baseline();
+#endif
@@ -0,0 +1,44 @@
+#include "task_plan.h"
+#include "diagnostics.h"
+
+// Núcleo de la tabla (-1 en menuconfig) para una tarea que puede ejecutarse en cualquiera
+#define TASK_PLAN_ANY_CORE -1
+
+// Tabla de prioridades y núcleos, en el orden de enum task_plan_id
+static const int plan[TASK_PLAN_NUM][2] = {
+    [TASK_PLAN_SAMPLING] = {CONFIG_TASK_PLAN_SAMPLING_PRIORITY, CONFIG_TASK_PLAN_SAMPLING_CORE},
+    [TASK_PLAN_BUTTON] = {CONFIG_TASK_PLAN_BUTTON_PRIORITY, CONFIG_TASK_PLAN_BUTTON_CORE},
+    [TASK_PLAN_OTA] = {CONFIG_TASK_PLAN_OTA_PRIORITY, CONFIG_TASK_PLAN_OTA_CORE},
+    [TASK_PLAN_OTA_WRITER] = {CONFIG_TASK_PLAN_OTA_WRITER_PRIORITY, CONFIG_TASK_PLAN_OTA_WRITER_CORE},
+    [TASK_PLAN_OTA_UART] = {CONFIG_TASK_PLAN_OTA_UART_PRIORITY, CONFIG_TASK_PLAN_OTA_UART_CORE},
+    [TASK_PLAN_DIAGNOSTICS] = {CONFIG_TASK_PLAN_DIAGNOSTICS_PRIORITY, CONFIG_TASK_PLAN_DIAGNOSTICS_CORE},
+};
+
+
+struct task_plan_entry task_plan_get(enum task_plan_id id){
+    struct task_plan_entry entry = {
+        .priority = plan[id][0],
+        .core = plan[id][1]
+    };
+    // Con un solo núcleo (o sin núcleo fijo) la tarea puede ejecutarse en cualquiera
+    if (entry.core == TASK_PLAN_ANY_CORE || entry.core >= portNUM_PROCESSORS) entry.core = tskNO_AFFINITY;
+    return entry;
+}
+
+BaseType_t task_plan_create(enum task_plan_id id, TaskFunction_t func, const char * name, uint32_t stack_size,
+                            void * arg, TaskHandle_t * handle){
+    struct task_plan_entry entry = task_plan_get(id);
+    return diagnostics_create_task(func, name, stack_size, arg, entry.priority, handle, entry.core);
+}
+
+#if CONFIG_STATIC_ALLOCATION
+TaskHandle_t task_plan_create_static(enum task_plan_id id, TaskFunction_t func, const char * name, uint32_t stack_size,
+                                     void * arg, StackType_t * stack, StaticTask_t * buffer){
+    struct task_plan_entry entry = task_plan_get(id);
+    TaskHandle_t handle = xTaskCreateStaticPinnedToCore(func, name, stack_size, arg, entry.priority, stack, buffer,
+                                                        entry.core);
+    // Solo se usa para tareas que no terminan, así que basta con registrarla después de crearla
+    diagnostics_watch_task(handle, stack_size);
+    return handle;
+}
+#endif
@@ -0,0 +1,48 @@
+#ifndef TASK_PLAN_H
+#define TASK_PLAN_H
+#include <stdint.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+/* Tareas de la aplicación. La prioridad y el núcleo de cada una salen de una única tabla configurable
+(menuconfig): el muestreo en la APP CPU y la red y los registros en la PRO CPU, junto al Wi-Fi.*/
+enum task_plan_id {
+    // Muestreo de temperatura
+    TASK_PLAN_SAMPLING,
+    // Tarea del botón
+    TASK_PLAN_BUTTON,
+    // Descarga y comprobación de actualizaciones (red)
+    TASK_PLAN_OTA,
+    // Escritura en flash de las actualizaciones
+    TASK_PLAN_OTA_WRITER,
+    // Recepción de actualizaciones por UART
+    TASK_PLAN_OTA_UART,
+    // Muestreo de pilas y heap
+    TASK_PLAN_DIAGNOSTICS,
+    TASK_PLAN_NUM
+};
+
+// Prioridad y núcleo de una tarea (tskNO_AFFINITY si puede ejecutarse en cualquiera)
+struct task_plan_entry {
+    UBaseType_t priority;
+    BaseType_t core;
+};
+
+// Devuelve la prioridad y el núcleo de una tarea
+struct task_plan_entry task_plan_get(enum task_plan_id id);
+/* Crea una tarea con la prioridad y el núcleo de la tabla (mismos argumentos que xTaskCreate) y la
+pone bajo la vigilancia de pila del módulo de diagnóstico*/
+BaseType_t task_plan_create(enum task_plan_id id, TaskFunction_t func, const char * name, uint32_t stack_size,
+                            void * arg, TaskHandle_t * handle);
+#if CONFIG_STATIC_ALLOCATION
+/* Igual que task_plan_create pero sobre una pila y un bloque de control reservados en tiempo de enlazado
+("stack" con "stack_size" bytes). Devuelve el handle de la tarea o NULL si no se puede crear*/
+TaskHandle_t task_plan_create_static(enum task_plan_id id, TaskFunction_t func, const char * name, uint32_t stack_size,
+                                     void * arg, StackType_t * stack, StaticTask_t * buffer);
+#endif
+#if CONFIG_TASK_PLAN_BENCHMARK
+/* Mide el retraso de una tarea de muestreo con carga sintética de red y de registros, primero con todas
+las tareas a la misma prioridad y sin fijar a un núcleo y después con la tabla, y muestra los resultados*/
+void task_plan_benchmark();
+#endif
+#endif
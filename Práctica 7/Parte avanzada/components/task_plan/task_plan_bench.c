@@ -0,0 +1,91 @@
+#include <esp_log.h>
+#include <esp_timer.h>
+#include "periodic_task.h"
+#include "task_plan.h"
+#include "diagnostics.h"
+
+// Duración de cada prueba y periodo de la tarea de muestreo
+#define BENCH_RUN_MS (CONFIG_TASK_PLAN_BENCHMARK_SEC * 1000)
+#define BENCH_SAMPLING_PERIOD_MS 10
+// Carga de red sintética: ráfagas de CPU (como el procesado de paquetes) en varias tareas
+#define NET_TASKS 2
+#define NET_BURST_US 3000
+#define NET_PERIOD_MS 5
+#define BENCH_STACK_SIZE 2048
+
+static const char* TAG = "task_plan bench";
+
+// Las tareas de carga terminan cuando se pone a false
+static volatile bool load_running;
+
+// Cuerpo de la tarea de muestreo (trabajo corto, como una lectura)
+static void sampling_body(void * args);
+// Carga de red: ráfagas de CPU separadas por esperas cortas
+static void network_load_task(void * args);
+// Carga de registros: mensajes seguidos por el puerto serie
+static void log_load_task(void * args);
+// Crea una tarea de carga con la tabla o, como se hacía antes, con la prioridad de quien la crea y sin núcleo fijo
+static void create_load(TaskFunction_t func, const char * name, bool planned);
+// Ejecuta una prueba y muestra el retraso de la tarea de muestreo
+static void run_bench(bool planned);
+
+
+static void sampling_body(void * args){
+    volatile uint32_t sum = 0;
+    for (int i = 0; i < 100; i++) sum += i;
+}
+
+static void network_load_task(void * args){
+    while (load_running){
+        int64_t end = esp_timer_get_time() + NET_BURST_US;
+        while (esp_timer_get_time() < end);
+        vTaskDelay(pdMS_TO_TICKS(NET_PERIOD_MS));
+    }
+    diagnostics_task_exit();
+    vTaskDelete(NULL);
+}
+
+static void log_load_task(void * args){
+    unsigned int line = 0;
+    while (load_running){
+        ESP_LOGI(TAG, "synthetic log line %u", line++);
+        taskYIELD();
+    }
+    diagnostics_task_exit();
+    vTaskDelete(NULL);
+}
+
+static void create_load(TaskFunction_t func, const char * name, bool planned){
+    if (planned) task_plan_create(TASK_PLAN_OTA, func, name, BENCH_STACK_SIZE, NULL, NULL);
+    else xTaskCreate(func, name, BENCH_STACK_SIZE, NULL, uxTaskPriorityGet(NULL), NULL);
+}
+
+static void run_bench(bool planned){
+    load_running = true;
+    for (int i = 0; i < NET_TASKS; i++) create_load(network_load_task, "bench_net", planned);
+    create_load(log_load_task, "bench_log", planned);
+    struct task_plan_entry entry = { .priority = uxTaskPriorityGet(NULL), .core = tskNO_AFFINITY };
+    if (planned) entry = task_plan_get(TASK_PLAN_SAMPLING);
+    struct periodic_task * sampling = periodic_task_create("bench_sampling", sampling_body, NULL, BENCH_SAMPLING_PERIOD_MS,
+                                                           PERIODIC_TASK_SKIP, BENCH_STACK_SIZE, entry.priority, entry.core);
+    if (sampling == NULL) {
+        load_running = false;
+        ESP_LOGE(TAG, "Could not create the sampling task");
+        return;
+    }
+    vTaskDelay(pdMS_TO_TICKS(BENCH_RUN_MS));
+    struct periodic_task_stats stats;
+    periodic_task_get_stats(sampling, &stats);
+    periodic_task_delete(sampling);
+    // Dejamos que las tareas de carga terminen antes de mostrar el resultado
+    load_running = false;
+    vTaskDelay(pdMS_TO_TICKS(100));
+    ESP_LOGI(TAG, "%s: sampling lateness mean %lld us, max %lld us, %u missed of %u runs",
+             planned ? "task plan" : "same priority, no affinity", stats.runs > 0 ? stats.total_lateness_us / stats.runs : 0,
+             stats.max_lateness_us, stats.missed, stats.runs);
+}
+
+void task_plan_benchmark(){
+    run_bench(false);
+    run_bench(true);
+}
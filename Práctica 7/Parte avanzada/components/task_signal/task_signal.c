@@ -0,0 +1,27 @@
+#include <esp_attr.h>
+#include "task_signal.h"
+
+
+void task_signal_send(TaskHandle_t task, uint32_t bits){
+    xTaskNotify(task, bits, eSetBits);
+}
+
+void IRAM_ATTR task_signal_send_from_isr(TaskHandle_t task, uint32_t bits, BaseType_t * task_woken){
+    xTaskNotifyFromISR(task, bits, eSetBits, task_woken);
+}
+
+uint32_t task_signal_wait(uint32_t bits, TickType_t timeout){
+    TimeOut_t time_out;
+    vTaskSetTimeOutState(&time_out);
+    /* Una espera anterior puede haber dejado bits pendientes sin que la notificación conste como pendiente:
+    una notificación sin acción la marca como pendiente para que la primera espera lea los bits sin bloquear*/
+    xTaskNotify(xTaskGetCurrentTaskHandle(), 0, eNoAction);
+    uint32_t value;
+    while (1){
+        // Al salir solo se borran los bits que esperamos
+        if (xTaskNotifyWait(0, bits, &value, timeout) != pdTRUE) return 0;
+        if (value & bits) return value & bits;
+        // Han llegado otros bits: seguimos esperando el tiempo que quede
+        if (xTaskCheckForTimeOut(&time_out, &timeout) == pdTRUE) return 0;
+    }
+}
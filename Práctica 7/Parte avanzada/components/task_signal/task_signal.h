@@ -0,0 +1,29 @@
+#ifndef TASK_SIGNAL_H
+#define TASK_SIGNAL_H
+#include <stdint.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+/* Bits de señal de la aplicación. Cada tarea usa su valor de notificación como un conjunto de 32 bits de
+evento independientes, así que un bit solo puede tener un consumidor; se definen todos aquí para no repetirlos.*/
+// Flanco en la entrada del botón (ISR -> tarea del botón)
+#define SIGNAL_BUTTON_EDGE (1 << 0)
+// El escritor de la OTA ha terminado (tarea del escritor -> tarea que lo para)
+#define SIGNAL_OTA_WRITER_DONE (1 << 1)
+// Señal de la prueba de rendimiento
+#define SIGNAL_BENCH (1 << 31)
+
+// Activa los bits "bits" de la tarea "task" y la despierta si los está esperando
+void task_signal_send(TaskHandle_t task, uint32_t bits);
+/* Lo mismo desde una ISR. Pone "task_woken" a pdTRUE si hay que hacer un cambio de contexto al salir
+(portYIELD_FROM_ISR), como las funciones FromISR de FreeRTOS.*/
+void task_signal_send_from_isr(TaskHandle_t task, uint32_t bits, BaseType_t * task_woken);
+/* Espera hasta "timeout" a que la tarea actual reciba alguno de los bits "bits". Devuelve los que han llegado
+(y los borra) o 0 si se agota el tiempo; los demás bits recibidos siguen pendientes para otra espera.*/
+uint32_t task_signal_wait(uint32_t bits, TickType_t timeout);
+#if CONFIG_TASK_SIGNAL_BENCHMARK
+/* Mide la latencia desde que una ISR o el callback de un esp_timer avisan hasta que la tarea despierta,
+con semáforo binario y con notificaciones, y muestra los resultados*/
+void task_signal_benchmark();
+#endif
+#endif
@@ -0,0 +1,167 @@
+#include <esp_log.h>
+#include <esp_attr.h>
+#include <esp_cpu.h>
+#include <esp_timer.h>
+#include <esp_private/esp_clk.h>
+#include <driver/timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include "task_signal.h"
+
+// Avisos que se miden en cada prueba y periodo entre ellos
+#define BENCH_SIGNALS CONFIG_TASK_SIGNAL_BENCHMARK_SIGNALS
+#define BENCH_PERIOD_US 1000
+// Timer hardware que genera la interrupción de la prueba desde ISR
+#define BENCH_TIMER_GROUP TIMER_GROUP_0
+#define BENCH_TIMER_IDX TIMER_0
+// Divisor del timer hardware (APB de 80 MHz -> 1 MHz)
+#define BENCH_TIMER_DIVIDER 80
+/* Núcleo y prioridad de la tarea que despierta. La tarea de los esp_timer está en el núcleo 0 y la
+interrupción se reserva en el núcleo que configura el timer: así el contador de ciclos es el mismo para
+el que avisa y para el que despierta, y la tarea, con más prioridad que la de los esp_timer, despierta enseguida.*/
+#define BENCH_CORE 0
+#define BENCH_PRIORITY (configMAX_PRIORITIES - 2)
+#define BENCH_STACK_SIZE 2048
+
+static const char* TAG = "task_signal bench";
+
+// Contexto desde el que se avisa y mecanismo con el que se avisa
+enum bench_context { BENCH_FROM_ISR, BENCH_FROM_TIMER };
+enum bench_mechanism { BENCH_SEMAPHORE, BENCH_NOTIFICATION };
+
+// Prueba en curso
+static enum bench_mechanism mechanism;
+static SemaphoreHandle_t bench_semaphore;
+static TaskHandle_t waiter_handle;
+// Contador de ciclos en el momento del aviso (lo escribe el productor y lo lee la tarea al despertar)
+static volatile uint32_t signal_ccount;
+// Ciclos acumulados y máximos, y avisos recibidos
+static uint64_t total_cycles;
+static uint32_t max_cycles;
+static volatile uint32_t received;
+
+// Avisa a la tarea con el mecanismo de la prueba en curso (desde ISR o no)
+static bool IRAM_ATTR signal_waiter(bool from_isr);
+// Rutina de la interrupción del timer hardware
+static bool IRAM_ATTR bench_timer_isr(void * args);
+// Callback del esp_timer
+static void bench_esp_timer_callback(void * args);
+// Tarea que espera los avisos y mide cuánto tarda en despertar
+static void waiter_task(void * args);
+// Ejecuta una prueba y muestra su resultado
+static void run_bench(enum bench_context context, enum bench_mechanism bench_mechanism);
+// Tarea que ejecuta las pruebas en el núcleo de medida
+static void bench_task(void * args);
+
+
+static bool IRAM_ATTR signal_waiter(bool from_isr){
+    BaseType_t task_woken = pdFALSE;
+    signal_ccount = esp_cpu_get_ccount();
+    if (mechanism == BENCH_SEMAPHORE) {
+        if (from_isr) xSemaphoreGiveFromISR(bench_semaphore, &task_woken);
+        else xSemaphoreGive(bench_semaphore);
+    }
+    else {
+        if (from_isr) task_signal_send_from_isr(waiter_handle, SIGNAL_BENCH, &task_woken);
+        else task_signal_send(waiter_handle, SIGNAL_BENCH);
+    }
+    return task_woken == pdTRUE;
+}
+
+static bool IRAM_ATTR bench_timer_isr(void * args){
+    // El driver hace el cambio de contexto al salir si devolvemos true
+    return signal_waiter(true);
+}
+
+static void bench_esp_timer_callback(void * args){
+    signal_waiter(false);
+}
+
+static void waiter_task(void * args){
+    while (1){
+        if (mechanism == BENCH_SEMAPHORE) {
+            while (xSemaphoreTake(bench_semaphore, portMAX_DELAY) != pdTRUE);
+        }
+        else {
+            while (task_signal_wait(SIGNAL_BENCH, portMAX_DELAY) == 0);
+        }
+        uint32_t cycles = esp_cpu_get_ccount() - signal_ccount;
+        total_cycles += cycles;
+        if (cycles > max_cycles) max_cycles = cycles;
+        received++;
+    }
+    vTaskDelete(NULL);
+}
+
+static void run_bench(enum bench_context context, enum bench_mechanism bench_mechanism){
+    mechanism = bench_mechanism;
+    total_cycles = 0;
+    max_cycles = 0;
+    received = 0;
+    // Descartamos un aviso de una prueba anterior que haya quedado en el semáforo
+    xSemaphoreTake(bench_semaphore, 0);
+    // Una tarea nueva en cada prueba: la anterior se queda bloqueada en el mecanismo de su prueba
+    xTaskCreatePinnedToCore(waiter_task, "signal_bench", BENCH_STACK_SIZE, NULL, BENCH_PRIORITY, &waiter_handle, BENCH_CORE);
+    esp_timer_handle_t periodic_timer = NULL;
+    if (context == BENCH_FROM_ISR) {
+        timer_config_t config = {
+            .divider = BENCH_TIMER_DIVIDER,
+            .counter_dir = TIMER_COUNT_UP,
+            .counter_en = TIMER_PAUSE,
+            .alarm_en = TIMER_ALARM_EN,
+            .auto_reload = TIMER_AUTORELOAD_EN,
+        };
+        ESP_ERROR_CHECK(timer_init(BENCH_TIMER_GROUP, BENCH_TIMER_IDX, &config));
+        ESP_ERROR_CHECK(timer_set_counter_value(BENCH_TIMER_GROUP, BENCH_TIMER_IDX, 0));
+        ESP_ERROR_CHECK(timer_set_alarm_value(BENCH_TIMER_GROUP, BENCH_TIMER_IDX, BENCH_PERIOD_US));
+        ESP_ERROR_CHECK(timer_enable_intr(BENCH_TIMER_GROUP, BENCH_TIMER_IDX));
+        ESP_ERROR_CHECK(timer_isr_callback_add(BENCH_TIMER_GROUP, BENCH_TIMER_IDX, bench_timer_isr, NULL, ESP_INTR_FLAG_IRAM));
+        ESP_ERROR_CHECK(timer_start(BENCH_TIMER_GROUP, BENCH_TIMER_IDX));
+    }
+    else {
+        const esp_timer_create_args_t timer_args = {
+            .callback = &bench_esp_timer_callback,
+            .name = "Signal bench timer"
+        };
+        ESP_ERROR_CHECK(esp_timer_create(&timer_args, &periodic_timer));
+        ESP_ERROR_CHECK(esp_timer_start_periodic(periodic_timer, BENCH_PERIOD_US));
+    }
+    while (received < BENCH_SIGNALS) vTaskDelay(pdMS_TO_TICKS(10));
+    if (context == BENCH_FROM_ISR) {
+        ESP_ERROR_CHECK(timer_pause(BENCH_TIMER_GROUP, BENCH_TIMER_IDX));
+        ESP_ERROR_CHECK(timer_isr_callback_remove(BENCH_TIMER_GROUP, BENCH_TIMER_IDX));
+        ESP_ERROR_CHECK(timer_deinit(BENCH_TIMER_GROUP, BENCH_TIMER_IDX));
+    }
+    else {
+        ESP_ERROR_CHECK(esp_timer_stop(periodic_timer));
+        ESP_ERROR_CHECK(esp_timer_delete(periodic_timer));
+    }
+    // Dejamos que la tarea atienda el último aviso antes de leer los resultados
+    vTaskDelay(pdMS_TO_TICKS(10));
+    vTaskDelete(waiter_handle);
+    uint32_t cycles_per_us = esp_clk_cpu_freq() / 1000000;
+    uint32_t mean_cycles = total_cycles / received;
+    ESP_LOGI(TAG, "%s -> task with %s: mean %u cycles (%u ns), max %u cycles (%u ns), %u signals",
+             context == BENCH_FROM_ISR ? "ISR" : "esp_timer", mechanism == BENCH_SEMAPHORE ? "binary semaphore" : "notification",
+             mean_cycles, mean_cycles * 1000 / cycles_per_us, max_cycles, max_cycles * 1000 / cycles_per_us, received);
+}
+
+static void bench_task(void * args){
+    TaskHandle_t caller = (TaskHandle_t) args;
+    bench_semaphore = xSemaphoreCreateBinary();
+    run_bench(BENCH_FROM_ISR, BENCH_SEMAPHORE);
+    run_bench(BENCH_FROM_ISR, BENCH_NOTIFICATION);
+    run_bench(BENCH_FROM_TIMER, BENCH_SEMAPHORE);
+    run_bench(BENCH_FROM_TIMER, BENCH_NOTIFICATION);
+    vSemaphoreDelete(bench_semaphore);
+    task_signal_send(caller, SIGNAL_BENCH);
+    vTaskDelete(NULL);
+}
+
+void task_signal_benchmark(){
+    // Las pruebas se ejecutan en una tarea en el núcleo de medida (la interrupción se reserva en ese núcleo)
+    xTaskCreatePinnedToCore(bench_task, "signal_bench_run", 3072, xTaskGetCurrentTaskHandle(),
+                            uxTaskPriorityGet(NULL), NULL, BENCH_CORE);
+    task_signal_wait(SIGNAL_BENCH, portMAX_DELAY);
+}
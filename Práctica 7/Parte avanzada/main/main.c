@@ -1,59 +1,87 @@
+#include <stdlib.h>
 #include <esp_log.h>
 #include <freertos/FreeRTOS.h>
-#include <freertos/semphr.h>
+#include <esp_timer.h>
+#include <esp_system.h>
+#include <esp_console.h>
 #include "si7021.h"
+#include "crc.h"
+#include "selftest.h"
 #include "button.h"
 #include "ota.h"
+#include "periodic_task.h"
+#include "task_signal.h"
+#include "task_plan.h"
+#include "diagnostics.h"
 
 // Periodo de muestreo de temperatura
 #define TEMP_PERIOD_MS CONFIG_TEMP_PERIOD_MS
+// Pila de la tarea de muestreo de temperatura
+#define TEMP_TASK_STACK_SIZE 2048
+// Polinomio del crc del sensor y tamaño del bloque con el que se mide el rendimiento del crc
+#define POLYNOMIAL_CRC 0x131
+#define CRC_BENCH_SIZE 1024
+// Margen absoluto de memoria que puede perderse en el autotest sin considerarlo una fuga
+#define HEAP_LEAK_SLACK_BYTES 256
+// Margen mínimo de pila (absoluto) que deben conservar las tareas en marcha para aceptar la imagen
+#define STACK_MARGIN_MIN_BYTES 256
 
 // Etiqueta para los mensajes por puerto serie
 static const char* TAG = "Main";
-// Semáforo para que el timer avise a la tarea de que toca leer
-static SemaphoreHandle_t get_temp_semaphore;
-// Callback del timer periódico
-static void temp_timer_callback(void * args);
-// Tarea que lee y muestra la temperatura
-static void task_get_temp(void * args);
-// Función para configurar el timer
-static void config_timer();
+/* Tarea periódica que lee la temperatura. Sus estadísticas de retraso respecto a los instantes de muestreo
+se reinician al empezar una actualización OTA para medir cómo le afecta.*/
+static struct periodic_task * temp_task;
+// Lee y muestra la temperatura (lo ejecuta periódicamente la tarea de temperatura)
+static void get_temp(void * args);
+// Manejador de los eventos de la actualización OTA (muestra el progreso y el retraso del muestreo durante la misma)
+static void ota_event_handler(void* handler_args, esp_event_base_t base, int32_t id, void* event_data);
 /* Función de diagnóstico para determinar si la imagen actual es correcta (se llamaŕa solo cuando la imagen esté pendiente de verificar).
 La función chequea las dos funcionalidad de la aplicación: la lectura de temperatura del sensor y la descarga remota de un una imagen por http.*/ 
 static bool self_test();
+// Micro-benchmarks del autotest: latencia media de lectura por i2c (us)
+static bool bench_i2c_latency(uint32_t * value);
+// Rendimiento del cálculo del crc (KB/s)
+static bool bench_crc_throughput(uint32_t * value);
+// Memoria perdida tras varias lecturas del sensor (bytes)
+static bool bench_heap_leak(uint32_t * value);
+// Comprueba que las tareas que ya están en marcha conservan al menos STACK_MARGIN_MIN_BYTES de pila
+static bool check_stack_margin();
+#if CONFIG_CONSOLE
+// Arranca la consola con los comandos de diagnóstico y de ota
+static void start_console();
+#endif
 
 
-static void temp_timer_callback(void * args){
-    // Avisamos de que toca leer la temperatura
-    xSemaphoreGive(get_temp_semaphore);
+static void get_temp(void * args){
+    // Mostramos el valor de temperatura
+    ESP_LOGI(TAG, "Temperature: %.2fºC", si7021_get_temp(true));
 }
 
-static void config_timer(){
-    // Manejador del timer
-    esp_timer_handle_t periodic_timer;
-    // Preparemos los argumentos del timer periódico para el muestreo.
-    const esp_timer_create_args_t periodic_timer_args = {
-        .callback = &temp_timer_callback,
-        .name = "Temp sampling timer"
-    };
-    // Configuramos el timer con los mencionados argumentos.
-    ESP_ERROR_CHECK(esp_timer_create(&periodic_timer_args, &periodic_timer));
-    // Creamos un semáforo con el que el timer avisará para la lectura
-    get_temp_semaphore = xSemaphoreCreateBinary();
-    // Iniciamos el timer con el periodo de lectura
-    ESP_ERROR_CHECK(esp_timer_start_periodic(periodic_timer, TEMP_PERIOD_MS * 1000));
-}
-
-static void task_get_temp(void * args){
-    // De forma indefinida
-    while(1){
-        // Esperamos a que nos indiquen que es el momento de leer la temperatura
-        while(xSemaphoreTake( get_temp_semaphore, portMAX_DELAY ) != pdTRUE);      
-        // Mostramos el valor de temperatura
-        ESP_LOGI(TAG, "Temperature: %.2fºC", si7021_get_temp(true));
+static void ota_event_handler(void* handler_args, esp_event_base_t base, int32_t id, void* event_data){
+    switch (id){
+        // Al empezar una actualización reiniciamos las estadísticas de retraso del muestreo
+        case OTA_EVENT_STARTED:
+            // (la tarea de temperatura se crea al final de app_main: puede que aún no exista)
+            if (temp_task != NULL) periodic_task_reset_stats(temp_task);
+            ESP_LOGI(TAG, "OTA update started");
+            break;
+        case OTA_EVENT_PROGRESS:;
+            struct ota_progress_event * progress = (struct ota_progress_event *) event_data;
+            ESP_LOGI(TAG, "OTA progress: %u/%u bytes", progress->bytes_done, progress->bytes_total);
+            break;
+        // Al acabar (de cualquier forma) mostramos el retraso de muestreo que ha habido durante la actualización
+        case OTA_EVENT_FINISHED:
+        case OTA_EVENT_FAILED:
+        case OTA_EVENT_CANCELLED:;
+            struct periodic_task_stats stats = {0};
+            if (temp_task != NULL) periodic_task_get_stats(temp_task, &stats);
+            ESP_LOGI(TAG, "Sampling lateness during OTA: max %lld us, mean %lld us (%u samples, %u missed)",
+                     stats.max_lateness_us, stats.runs > 0 ? stats.total_lateness_us / stats.runs : 0,
+                     stats.runs, stats.missed);
+            break;
+        default:
+            break;
     }
-    // Nunca llegará aquí, pero es buena práctica poner el delete de la tarea
-    vTaskDelete(NULL);
 }
 
 static bool self_test(){
@@ -64,26 +92,131 @@ static bool self_test(){
     incluso en la elección de parámetros como el polinomio de redundancia cíclica). Finalmente, comprueba que el valor de temperatura está dentro del rango medible según
     el datasheet ([-40ºC, 125ºC]); esto previene de errores en la imagen para calcular la temperatura a partir de los bytes devueltos por el
     sensor (si sale un resultado disparatado es que la aplicación presenta algún error).*/
-    return si7021_temp_correct_test();
+    if (!si7021_temp_correct_test()) return false;
+    /* El margen de pila varía decenas de bytes entre arranques y con cambios de código ajenos, así que no se
+    compara con la imagen anterior: solo se exige un mínimo absoluto.*/
+    if (!check_stack_margin()) return false;
+    /* Además, la nueva imagen no debe empeorar el rendimiento: se comparan los micro-benchmarks con los
+    presupuestos guardados por la imagen anterior y si hay una regresión se hace rollback.*/
+    return selftest_run();
+}
+
+static bool bench_i2c_latency(uint32_t * value){
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < SELFTEST_SAMPLES; i++) {
+        float temp = si7021_get_temp(true);
+        if (temp < -40 || temp > 125) return false;
+    }
+    *value = (esp_timer_get_time() - start) / SELFTEST_SAMPLES;
+    return true;
+}
+
+static bool bench_crc_throughput(uint32_t * value){
+    static uint8_t data[CRC_BENCH_SIZE];
+    for (int i = 0; i < CRC_BENCH_SIZE; i++) data[i] = i;
+    // El resultado se acumula para que el compilador no pueda eliminar los cálculos
+    volatile uint8_t crc = 0;
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < SELFTEST_SAMPLES; i++) crc ^= crc8(data, CRC_BENCH_SIZE, POLYNOMIAL_CRC);
+    int64_t elapsed_us = esp_timer_get_time() - start;
+    if (elapsed_us <= 0) elapsed_us = 1;
+    *value = (int64_t) CRC_BENCH_SIZE * SELFTEST_SAMPLES * 1000000 / 1024 / elapsed_us;
+    return true;
+}
+
+static bool bench_heap_leak(uint32_t * value){
+    // La primera lectura puede reservar memoria que se mantiene (drivers, logs): no cuenta como fuga
+    si7021_get_temp(true);
+    uint32_t before = esp_get_free_heap_size();
+    for (int i = 0; i < SELFTEST_SAMPLES; i++) si7021_get_temp(true);
+    uint32_t after = esp_get_free_heap_size();
+    *value = before > after ? before - after : 0;
+    return true;
+}
+
+static bool check_stack_margin(){
+    /* Tareas creadas hasta este momento: la principal (la prueba se ejecuta en ella), la del botón y la de los
+    timers (de ESP-IDF, que no da su handle: se busca por su nombre)*/
+    TaskHandle_t tasks[] = { xTaskGetCurrentTaskHandle(), button_get_task(), xTaskGetHandle("esp_timer") };
+    uint32_t min_margin = UINT32_MAX;
+    for (int i = 0; i < sizeof(tasks) / sizeof(tasks[0]); i++) {
+        if (tasks[i] == NULL) continue;
+        uint32_t margin = uxTaskGetStackHighWaterMark(tasks[i]);
+        if (margin < min_margin) min_margin = margin;
+    }
+    if (min_margin == UINT32_MAX) return false;
+    if (min_margin < STACK_MARGIN_MIN_BYTES) {
+        ESP_LOGE(TAG, "Stack margin of %u bytes, below the minimum of %u", min_margin, STACK_MARGIN_MIN_BYTES);
+        return false;
+    }
+    return true;
+}
+
+#if CONFIG_CONSOLE
+static void start_console(){
+    esp_console_repl_t *repl = NULL;
+    esp_console_repl_config_t repl_config = ESP_CONSOLE_REPL_CONFIG_DEFAULT();
+    repl_config.prompt = "esp32>";
+    esp_console_register_help_command();
+    register_diagnostics();
+    register_ota();
+    esp_console_dev_uart_config_t hw_config = ESP_CONSOLE_DEV_UART_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(esp_console_new_repl_uart(&hw_config, &repl_config, &repl));
+    ESP_ERROR_CHECK(esp_console_start_repl(repl));
 }
+#endif
 
 void app_main(void){
     /* Todas las configuraciones e inicializaciones del principio abortan la ejecución en caso de fallo
     y, por tanto, ya se desecha la nueva imagen si fallan (se pasará de estado VERIFY_PENDING a ABORTED).
     Entendemos que si no se puede inicializar alguna de los recursos, la ejecución no debe continuar y,
     por lo tanto, lo tratamos como errores irrecuperables.*/
+    // Vigilamos el uso de pila desde el principio (de esta tarea y de las que se creen con la tabla de tareas)
+    diagnostics_init(CONFIG_ESP_MAIN_TASK_STACK_SIZE);
+#if CONFIG_TASK_PLAN_BENCHMARK
+    // Retraso del muestreo con carga de red y de registros, sin y con la tabla de prioridades y núcleos
+    task_plan_benchmark();
+#endif
+#if CONFIG_TASK_SIGNAL_BENCHMARK
+    // Latencia de despertar una tarea con semáforo binario y con notificaciones (antes de que arranque nada más)
+    task_signal_benchmark();
+#endif
     // Realizamos la inicialización para ota
     ota_init();
-    // Configuramos el botón para que se ejecuta la actualización con ota cuando se presione
-    config_button(ota_update);
+    // Con la NVS lista mostramos el resumen de memoria del arranque anterior y empezamos a muestrear pilas y heap
+    struct task_plan_entry diagnostics = task_plan_get(TASK_PLAN_DIAGNOSTICS);
+    diagnostics_start(diagnostics.priority, diagnostics.core);
+    // Atendemos los eventos de la actualización para mostrar su progreso
+    ESP_ERROR_CHECK(esp_event_handler_register(OTA_EVENT, ESP_EVENT_ANY_ID, ota_event_handler, NULL));
+    /* Configuramos el botón para que lance la actualización con ota cuando se presione (se ejecuta en
+    segundo plano con baja prioridad, sin bloquear la tarea del botón) y la cancele con una pulsación larga*/
+    config_button(ota_update_start, ota_update_cancel);
+#if CONFIG_OTA_UART_ENABLE
+    // Las imágenes también pueden llegar por UART (estaciones de banco o nodos sin red)
+    ota_uart_start();
+#endif
     // Inicializamos el sensor
     si7021_init();
-    // Configuramos el timer para muestrear periódicamente la temperatura
-    config_timer();
+    // Micro-benchmarks con los que se decide si una imagen nueva ha empeorado el rendimiento
+    selftest_register("i2c_read", "us", bench_i2c_latency, SELFTEST_LOWER_IS_BETTER, 0);
+    selftest_register("crc_speed", "KB/s", bench_crc_throughput, SELFTEST_HIGHER_IS_BETTER, 0);
+    selftest_register("heap_leak", "bytes", bench_heap_leak, SELFTEST_LOWER_IS_BETTER, HEAP_LEAK_SLACK_BYTES);
     /* Si la inicialización se ha hecho correctamente, comprobamos la funcionalidad de la aplicación para marcar
     la imagen como válida y usarla en futuros inicios.*/
     verify_image(self_test);
-    /* Creamos la tarea que mostrará que pedirá la temperatura al sensor y la mostrará (en el callback del timer no podemos
-    llamar a una función potencialmente bloqueante como la lectura de temperatura) */
-    xTaskCreate(task_get_temp, "Task get temperature", 2048, NULL, uxTaskPriorityGet(NULL), NULL);
+    // La imagen de fábrica (que no pasa por la verificación) también deja presupuestos para la siguiente
+    selftest_record_baseline();
+    /* Creamos la tarea que pedirá periódicamente la temperatura al sensor y la mostrará. Espera a instantes
+    absolutos, sin timer ni semáforo intermedios; si pierde alguno (p. ej. durante una OTA) lo salta.
+    Su prioridad y núcleo salen de la tabla de tareas (en la APP CPU, lejos del Wi-Fi).*/
+    struct task_plan_entry sampling = task_plan_get(TASK_PLAN_SAMPLING);
+    temp_task = periodic_task_create("Task get temperature", get_temp, NULL, TEMP_PERIOD_MS, PERIODIC_TASK_SKIP,
+                                     TEMP_TASK_STACK_SIZE, sampling.priority, sampling.core);
+    if (temp_task == NULL) ESP_LOGE(TAG, "Could not start the temperature sampling");
+    else diagnostics_watch_task(periodic_task_get_handle(temp_task), TEMP_TASK_STACK_SIZE);
+#if CONFIG_CONSOLE
+    start_console();
+#endif
+    // La tarea principal termina al volver de app_main: anotamos su margen de pila y dejamos de vigilarla
+    diagnostics_task_exit();
 }
\ No newline at end of file
@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+"""Genera paquetes OTA comprimidos o parches delta que entiende el componente ota (ota_package.c).
+
+    python3 ota_pack.py full new.bin -o new.pkg
+    python3 ota_pack.py delta old.bin new.bin -o new.delta
+
+Formato: cabecera sin comprimir (magic "AOTA", tipo, tamaño de la imagen resultante y SHA-256 del ELF
+de la imagen base) seguida de un flujo zlib. En los parches el flujo descomprimido es una secuencia de
+operaciones 'C' <origen u32> <longitud u32> (copiar de la imagen en ejecución) e 'I' <longitud u32> <datos>
+(insertar bytes nuevos), con enteros little endian.
+"""
+import argparse
+import struct
+import sys
+import time
+import zlib
+
+MAGIC = 0x41544F41
+TYPE_FULL = 1
+TYPE_DELTA = 2
+HEADER = struct.Struct('<IB3xI32s')
+# Offset del SHA-256 del ELF dentro de la imagen: cabecera de imagen (24) + cabecera de segmento (8)
+# + campos de esp_app_desc_t anteriores a app_elf_sha256 (144)
+ELF_SHA_OFFSET = 24 + 8 + 144
+# Tamaño del bloque con el que se indexa la imagen base para buscar coincidencias
+BLOCK = 16
+# Longitud mínima para que compense una copia frente a insertar los bytes
+MIN_MATCH = 24
+
+
+def make_delta(old, new):
+    """Devuelve el flujo de operaciones que reconstruye "new" a partir de "old"."""
+    index = {}
+    for pos in range(0, len(old) - BLOCK + 1, BLOCK // 2):
+        index.setdefault(old[pos:pos + BLOCK], pos)
+    ops = bytearray()
+    literal = bytearray()
+    i = 0
+
+    def flush_literal():
+        if literal:
+            ops.extend(b'I' + struct.pack('<I', len(literal)) + literal)
+            literal.clear()
+
+    while i < len(new):
+        src = index.get(new[i:i + BLOCK])
+        if src is None:
+            literal.append(new[i])
+            i += 1
+            continue
+        # Extendemos la coincidencia hacia delante y hacia atrás (recuperando bytes ya marcados como literales)
+        length = BLOCK
+        while i + length < len(new) and src + length < len(old) and new[i + length] == old[src + length]:
+            length += 1
+        back = 0
+        while back < len(literal) and src - back > 0 and new[i - back - 1] == old[src - back - 1]:
+            back += 1
+        if length + back < MIN_MATCH:
+            literal.append(new[i])
+            i += 1
+            continue
+        if back:
+            del literal[len(literal) - back:]
+        flush_literal()
+        ops.extend(b'C' + struct.pack('<II', src - back, length + back))
+        i += length
+    flush_literal()
+    return bytes(ops)
+
+
+def apply_delta(old, ops):
+    """Aplica el parche en Python (misma lógica que el dispositivo) para verificarlo."""
+    out = bytearray()
+    i = 0
+    while i < len(ops):
+        op = ops[i:i + 1]
+        if op == b'C':
+            src, length = struct.unpack_from('<II', ops, i + 1)
+            out += old[src:src + length]
+            i += 9
+        elif op == b'I':
+            (length,) = struct.unpack_from('<I', ops, i + 1)
+            out += ops[i + 5:i + 5 + length]
+            i += 5 + length
+        else:
+            raise ValueError('invalid op at %d' % i)
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Build compressed / delta OTA packages')
+    sub = parser.add_subparsers(dest='cmd', required=True)
+    full = sub.add_parser('full', help='compressed full image')
+    full.add_argument('image')
+    full.add_argument('-o', '--output', required=True)
+    delta = sub.add_parser('delta', help='compressed delta patch against the running image')
+    delta.add_argument('base')
+    delta.add_argument('image')
+    delta.add_argument('-o', '--output', required=True)
+    parser.add_argument('--level', type=int, default=9, help='zlib compression level')
+    args = parser.parse_args()
+
+    with open(args.image, 'rb') as f:
+        image = f.read()
+    start = time.perf_counter()
+    if args.cmd == 'full':
+        header = HEADER.pack(MAGIC, TYPE_FULL, len(image), bytes(32))
+        body = image
+    else:
+        with open(args.base, 'rb') as f:
+            base = f.read()
+        body = make_delta(base, image)
+        if apply_delta(base, body) != image:
+            sys.exit('internal error: patch does not reproduce the image')
+        header = HEADER.pack(MAGIC, TYPE_DELTA, len(image), base[ELF_SHA_OFFSET:ELF_SHA_OFFSET + 32])
+    package = header + zlib.compress(body, args.level)
+    elapsed = time.perf_counter() - start
+    with open(args.output, 'wb') as f:
+        f.write(package)
+
+    # Pequeño informe: tamaño frente a la imagen original y rendimiento de la generación
+    print('image   %8d bytes' % len(image))
+    if args.cmd == 'delta':
+        print('patch   %8d bytes (uncompressed ops)' % len(body))
+    print('package %8d bytes (%.1f%% of image)' % (len(package), 100.0 * len(package) / len(image)))
+    print('built in %.2f s (%.0f KB/s of image)' % (elapsed, len(image) / 1024 / max(elapsed, 1e-6)))
+
+
+if __name__ == '__main__':
+    main()
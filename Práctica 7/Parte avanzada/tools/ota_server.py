@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+"""Servidor HTTPS local que hace de sustituto del servidor de actualizaciones OTA.
+
+Sirve una imagen con soporte de cabeceras Range/If-Range y ETag, y permite inyectar
+caídas de conexión para comprobar que la descarga se reanuda donde se quedó. También
+contesta a la comprobación de versión (HEAD con If-None-Match, 304 si no ha cambiado) y
+admite reanudación de sesiones TLS y conexiones persistentes:
+
+    python3 ota_server.py build/app.bin --cert server_certs/ca_cert.pem \
+        --key server_certs/ca_key.pem --port 8070 --drop-after 100000 --version 1.1
+"""
+import argparse
+import hashlib
+import http.server
+import os
+import re
+import ssl
+
+
+def make_handler(image_path, drop_after, version):
+    with open(image_path, 'rb') as f:
+        image = f.read()
+    etag = '"%s"' % hashlib.sha256(image).hexdigest()[:32]
+
+    class OtaHandler(http.server.BaseHTTPRequestHandler):
+        protocol_version = 'HTTP/1.1'
+
+        def _range_start(self):
+            # Solo atendemos el Range si el ETag de If-Range coincide (si no, imagen completa)
+            if_range = self.headers.get('If-Range')
+            if if_range is not None and if_range != etag:
+                return 0
+            match = re.match(r'bytes=(\d+)-$', self.headers.get('Range', ''))
+            return int(match.group(1)) if match else 0
+
+        def do_HEAD(self):
+            # Comprobación de versión: sin cuerpo, 304 si el dispositivo ya tiene esta imagen
+            if self.headers.get('If-None-Match') == etag:
+                self.send_response(304)
+                self.send_header('ETag', etag)
+                self.end_headers()
+                return
+            self.send_response(200)
+            self.send_header('Content-Type', 'application/octet-stream')
+            self.send_header('Content-Length', str(len(image)))
+            self.send_header('ETag', etag)
+            if version:
+                self.send_header('X-App-Version', version)
+            self.end_headers()
+
+        def do_GET(self):
+            start = self._range_start()
+            if start >= len(image):
+                self.send_response(416)
+                self.send_header('Content-Range', 'bytes */%d' % len(image))
+                self.send_header('Content-Length', '0')
+                self.end_headers()
+                return
+            body = image[start:]
+            self.send_response(206 if start > 0 else 200)
+            self.send_header('Content-Type', 'application/octet-stream')
+            self.send_header('Content-Length', str(len(body)))
+            self.send_header('ETag', etag)
+            self.send_header('Accept-Ranges', 'bytes')
+            if start > 0:
+                self.send_header('Content-Range', 'bytes %d-%d/%d' % (start, len(image) - 1, len(image)))
+            self.end_headers()
+            # Caída inyectada: cortamos la conexión tras enviar "drop_after" bytes de cuerpo
+            if drop_after and len(body) > drop_after:
+                self.wfile.write(body[:drop_after])
+                self.wfile.flush()
+                self.log_message('Dropping connection after %d bytes (offset %d)', drop_after, start + drop_after)
+                self.close_connection = True
+                self.connection.shutdown(2)
+                return
+            self.wfile.write(body)
+
+    return OtaHandler
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Local HTTPS stand-in for the OTA server')
+    parser.add_argument('image', help='firmware image (.bin) to serve')
+    parser.add_argument('--cert', required=True, help='server certificate (PEM)')
+    parser.add_argument('--key', required=True, help='server private key (PEM)')
+    parser.add_argument('--port', type=int, default=8070)
+    parser.add_argument('--drop-after', type=int, default=0,
+                        help='close every response after this many body bytes (0 = never)')
+    parser.add_argument('--version', default='',
+                        help='app version announced in X-App-Version to HEAD requests')
+    args = parser.parse_args()
+
+    server = http.server.ThreadingHTTPServer(('', args.port), make_handler(args.image, args.drop_after, args.version))
+    context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+    context.load_cert_chain(args.cert, args.key)
+    server.socket = context.wrap_socket(server.socket, server_side=True)
+    print('Serving %s (%d bytes) on port %d' % (args.image, os.path.getsize(args.image), args.port))
+    server.serve_forever()
+
+
+if __name__ == '__main__':
+    main()
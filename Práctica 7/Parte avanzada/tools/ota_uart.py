@@ -0,0 +1,175 @@
+#!/usr/bin/env python3
+"""Envía una imagen de firmware por UART al receptor OTA del componente ota (ota_uart.c).
+
+    python3 ota_uart.py /dev/ttyUSB0 build/app.bin --baud 921600
+
+Protocolo: tramas SOF (0xA5), tipo, longitud del payload (u16), secuencia (u32), payload y CRC-32
+(el de zlib) de todo lo anterior salvo el SOF, con enteros little endian. Tras START (tamaño de la
+imagen y de los trozos) el dispositivo contesta con la ventana que admite; los datos se envían con
+ventana deslizante y go-back-N (ACK acumulativo, NAK con la primera trama que falta) y END confirma
+el resultado. Para probar sin placa basta un par de pty (p. ej. socat -d -d pty,raw pty,raw).
+"""
+import argparse
+import os
+import random
+import select
+import struct
+import sys
+import termios
+import time
+import zlib
+
+SOF = 0xA5
+HEADER = struct.Struct('<BBHI')
+CRC = struct.Struct('<I')
+FRAME_START = ord('S')
+FRAME_DATA = ord('D')
+FRAME_END = ord('E')
+FRAME_ABORT = ord('X')
+FRAME_ACK = ord('A')
+FRAME_NAK = ord('N')
+# Tiempo sin respuesta tras el que se reenvía la ventana y reintentos máximos seguidos
+TIMEOUT_S = 1.0
+MAX_RETRIES = 10
+# Tiempo máximo de espera del resultado tras el END
+RESULT_TIMEOUT_S = 30.0
+
+
+class Link:
+    """Puerto serie en modo raw con lectura y escritura de tramas."""
+
+    def __init__(self, device, baud):
+        self.fd = os.open(device, os.O_RDWR | os.O_NOCTTY)
+        attrs = termios.tcgetattr(self.fd)
+        attrs[0] = attrs[1] = attrs[3] = 0
+        attrs[2] = termios.CS8 | termios.CREAD | termios.CLOCAL
+        speed = getattr(termios, 'B%d' % baud)
+        attrs[4] = attrs[5] = speed
+        termios.tcsetattr(self.fd, termios.TCSANOW, attrs)
+        termios.tcflush(self.fd, termios.TCIOFLUSH)
+        self.rx = bytearray()
+
+    def send(self, ftype, seq, payload=b'', corrupt=False):
+        body = HEADER.pack(SOF, ftype, len(payload), seq)[1:] + payload
+        frame = bytearray(bytes([SOF]) + body + CRC.pack(zlib.crc32(body)))
+        if corrupt:
+            frame[len(frame) // 2] ^= 0xFF
+        os.write(self.fd, frame)
+
+    def recv(self, timeout):
+        """Devuelve (tipo, secuencia, payload) o None si no llega una trama válida a tiempo."""
+        deadline = time.monotonic() + timeout
+        while True:
+            frame = self._parse()
+            if frame is not None:
+                return frame
+            remaining = deadline - time.monotonic()
+            if remaining <= 0 or not select.select([self.fd], [], [], remaining)[0]:
+                return None
+            self.rx += os.read(self.fd, 4096)
+
+    def _parse(self):
+        while True:
+            start = self.rx.find(bytes([SOF]))
+            if start < 0:
+                self.rx.clear()
+                return None
+            del self.rx[:start]
+            if len(self.rx) < HEADER.size:
+                return None
+            _, ftype, length, seq = HEADER.unpack_from(self.rx)
+            end = HEADER.size + length + CRC.size
+            if len(self.rx) < end:
+                return None
+            body = bytes(self.rx[1:HEADER.size + length])
+            (crc,) = CRC.unpack_from(self.rx, HEADER.size + length)
+            if crc == zlib.crc32(body):
+                del self.rx[:end]
+                return ftype, seq, body[HEADER.size - 1:]
+            # Trama corrupta: saltamos este SOF y buscamos el siguiente
+            del self.rx[:1]
+
+
+def send_image(link, image, chunk, max_window, corrupt_rate):
+    total = (len(image) + chunk - 1) // chunk
+    for _ in range(MAX_RETRIES):
+        link.send(FRAME_START, 0, struct.pack('<IH', len(image), chunk))
+        reply = link.recv(TIMEOUT_S)
+        if reply is not None and reply[0] == FRAME_ACK:
+            break
+        if reply is not None and reply[0] == FRAME_NAK:
+            sys.exit('device rejected the transfer')
+    else:
+        sys.exit('no answer from device')
+    (window,) = struct.unpack('<H', reply[2][:2])
+    window = max(1, min(window, max_window))
+    print('%d bytes in %d frames of %d bytes, window %d' % (len(image), total, chunk, window))
+
+    start = time.monotonic()
+    base = next_seq = 0
+    retries = resent = 0
+    while base < total:
+        while next_seq < total and next_seq < base + window:
+            corrupt = corrupt_rate > 0 and random.random() < corrupt_rate
+            link.send(FRAME_DATA, next_seq, image[next_seq * chunk:(next_seq + 1) * chunk], corrupt)
+            next_seq += 1
+        reply = link.recv(TIMEOUT_S)
+        if reply is None:
+            # Sin respuesta: volvemos a enviar la ventana desde la primera trama sin confirmar
+            retries += 1
+            if retries > MAX_RETRIES:
+                link.send(FRAME_ABORT, base)
+                sys.exit('transfer timed out at frame %d' % base)
+            resent += next_seq - base
+            next_seq = base
+            continue
+        ftype, seq, _ = reply
+        if ftype == FRAME_ACK and seq > base:
+            base = seq
+            retries = 0
+        elif ftype == FRAME_NAK and seq >= base:
+            resent += next_seq - seq
+            base = next_seq = seq
+        if base and base % max(1, total // 20) == 0:
+            print('\r%3d%%' % (base * 100 // total), end='', flush=True)
+    elapsed = time.monotonic() - start
+
+    # END puede perderse como cualquier otra trama: se reenvía hasta recibir el resultado (si lo que se pierde
+    # es la respuesta, el dispositivo contesta al END repetido con el mismo resultado). Verificar la imagen
+    # puede llevar varios segundos.
+    deadline = time.monotonic() + RESULT_TIMEOUT_S
+    reply = None
+    while reply is None and time.monotonic() < deadline:
+        link.send(FRAME_END, total)
+        reply = link.recv(TIMEOUT_S)
+        while reply is not None and len(reply[2]) != 4:
+            # ACK rezagados de las últimas tramas (o de un START repetido)
+            reply = link.recv(TIMEOUT_S)
+    if reply is None:
+        sys.exit('\nno result from device')
+    (result,) = struct.unpack('<i', reply[2][:4])
+    print('\r%d bytes in %.2f s (%.1f KB/s), %d frames resent' % (len(image), elapsed, len(image) / 1024 / max(elapsed, 1e-6), resent))
+    if reply[0] != FRAME_ACK:
+        sys.exit('device reported error %d' % result)
+    print('image accepted, device is restarting')
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Send a firmware image over UART')
+    parser.add_argument('device', help='serial device (e.g. /dev/ttyUSB0 or a pty)')
+    parser.add_argument('image', help='firmware image (.bin)')
+    parser.add_argument('--baud', type=int, default=921600)
+    parser.add_argument('--chunk', type=int, default=1024, help='data bytes per frame (divisor of 4096)')
+    parser.add_argument('--window', type=int, default=32, help='maximum frames in flight')
+    parser.add_argument('--corrupt', type=float, default=0.0,
+                        help='fraction of data frames to corrupt on purpose (link test)')
+    args = parser.parse_args()
+    if args.chunk <= 0 or 4096 % args.chunk:
+        sys.exit('chunk must divide 4096')
+    with open(args.image, 'rb') as f:
+        image = f.read()
+    send_image(Link(args.device, args.baud), image, args.chunk, args.window, args.corrupt)
+
+
+if __name__ == '__main__':
+    main()
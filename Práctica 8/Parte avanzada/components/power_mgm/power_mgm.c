@@ -4,6 +4,10 @@
 #include <esp_pm.h>
 #include <esp_sleep.h>
 #include "power_mgm.h"
+#include "task_plan.h"
+
+// Pila de la tarea que entra en deep sleep
+#define DEEP_SLEEP_TASK_STACK_SIZE CONFIG_DEEP_SLEEP_TASK_STACK_SIZE
 
 static const char* TAG = "Power management";
 
@@ -13,6 +17,14 @@ struct deep_sleep_args{
     int secs_deep_sleeping;
 };
 
+// Tiempos que recibe la tarea (solo hay una tarea de deep sleep, así que no hace falta reservarlos en el heap)
+static struct deep_sleep_args ds_args;
+#if CONFIG_STATIC_ALLOCATION
+// Memoria de la tarea de deep sleep, reservada en tiempo de enlazado
+static StackType_t deep_sleep_task_stack[DEEP_SLEEP_TASK_STACK_SIZE];
+static StaticTask_t deep_sleep_task_buffer;
+#endif
+
 // Callback de la tarea que entrará en deep sleep pasado el tiempo indicado durante el tiempo que se le diga
 static void deep_sleep_task(void * params);
 
@@ -27,8 +39,6 @@ static void deep_sleep_task(void * params){
     ESP_LOGI(TAG, "Entering deep sleep mode for %i s", ds_args->secs_deep_sleeping);
     // Configuramos un timer para salir de deep sleep en el tiempo indicado
     ESP_ERROR_CHECK_WITHOUT_ABORT(esp_sleep_enable_timer_wakeup(ds_args->secs_deep_sleeping * 1000 * 1000));
-    // Liberamos la memoria de la estrcutura con los tiempos
-    free(ds_args);
     // Entramos en depp sleep
     esp_deep_sleep_start();
     // No debería ejecutarse nunca, pero por si acaso
@@ -36,13 +46,17 @@ static void deep_sleep_task(void * params){
 }
 
 void deep_sleep_config(int secs_before_deep_sleep, int secs_deep_sleeping){
-    // Reservamos memoria del heap para pasar a la tarea los tiempos antes de deep sleep y durante deep sleep
-    struct deep_sleep_args * ds_args = (struct deep_sleep_args *) malloc(sizeof(struct deep_sleep_args));
-    // Copiamos los tiempos en la estructura
-    ds_args->secs_before_deep_sleep = secs_before_deep_sleep;
-    ds_args->secs_deep_sleeping = secs_deep_sleeping;
-    // Creamos la tares y le pasamos la estructura
-    xTaskCreate(deep_sleep_task, "Deep sleep task", 2048, ds_args, uxTaskPriorityGet(NULL), NULL);
+    // Copiamos los tiempos antes de deep sleep y durante deep sleep en la estructura que lee la tarea
+    ds_args.secs_before_deep_sleep = secs_before_deep_sleep;
+    ds_args.secs_deep_sleeping = secs_deep_sleeping;
+    // Creamos la tares y le pasamos la estructura (con la prioridad y el núcleo de la tabla de tareas)
+    struct task_plan_entry plan = task_plan_get(TASK_PLAN_DEEP_SLEEP);
+#if CONFIG_STATIC_ALLOCATION
+    xTaskCreateStaticPinnedToCore(deep_sleep_task, "Deep sleep task", DEEP_SLEEP_TASK_STACK_SIZE, &ds_args, plan.priority,
+                                  deep_sleep_task_stack, &deep_sleep_task_buffer, plan.core);
+#else
+    xTaskCreatePinnedToCore(deep_sleep_task, "Deep sleep task", DEEP_SLEEP_TASK_STACK_SIZE, &ds_args, plan.priority, NULL, plan.core);
+#endif
 }
 
 void power_manager_config(int max_freq_mhz, int min_freq_mhz, bool light_sleep){
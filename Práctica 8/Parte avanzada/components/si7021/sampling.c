@@ -4,32 +4,38 @@
 #include <nvs_flash.h>
 #include <nvs.h>
 #include "si7021.h"
+#include "periodic_task.h"
+#include "task_plan.h"
 static const char* TAG = "Sampling si7021";
 
-static void show_temp_task(void * params){
-    // Casteamos el periodo de muestreo recibido
-    unsigned int period_ms = (int) params;
+// Lee la temperatura, la muestra y la guarda en la NVS (lo ejecuta periódicamente la tarea de muestreo)
+static void show_temp(void * params);
+
+
+static void show_temp(void * params){
     nvs_handle_t nvs_handle;
-    while(1){
-        // Nos dormimos durante el periodo de muestreo antes de medir
-        vTaskDelay(pdMS_TO_TICKS(period_ms));
-        // Medimos la temperatura
-        float temp = si7021_get_temp(true);
-        // Mostramos la temperatua obtenida
-        ESP_LOGI(TAG, "Temperature: %.2fºC", temp);
-        // Abrimos la partición "storage" de la NVS para escritura obteniendo el correspondiente manjeador
-        ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_open("storage", NVS_READWRITE, &nvs_handle));
-        // Escribimos el valor leído como valor de la clave "last_temp" (con set_blob porque es un float)
-        ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_set_blob(nvs_handle, "last_temp", &temp, sizeof(temp)));
-        // Hacemos un commit para asegurar que la escritura se realiza
-        ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_commit(nvs_handle));
-        // Cerramos el almacenamiento NVS
-        nvs_close(nvs_handle);
-    }
-    vTaskDelete(NULL);
+    // Medimos la temperatura
+    float temp = si7021_get_temp(true);
+    // Mostramos la temperatua obtenida
+    ESP_LOGI(TAG, "Temperature: %.2fºC", temp);
+    // Abrimos la partición "storage" de la NVS para escritura obteniendo el correspondiente manjeador
+    ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_open("storage", NVS_READWRITE, &nvs_handle));
+    // Escribimos el valor leído como valor de la clave "last_temp" (con set_blob porque es un float)
+    ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_set_blob(nvs_handle, "last_temp", &temp, sizeof(temp)));
+    // Hacemos un commit para asegurar que la escritura se realiza
+    ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_commit(nvs_handle));
+    // Cerramos el almacenamiento NVS
+    nvs_close(nvs_handle);
 }
 
 void periodic_sampling_temp(unsigned int period_ms){
-    // Creamos la tarea que leerá y mostrará la temperatura periódicamente
-    xTaskCreate(show_temp_task, "Task show temperature", 2048, (void*) period_ms, uxTaskPriorityGet(NULL), NULL);
+    /* Creamos la tarea que leerá y mostrará la temperatura periódicamente. Los instantes de lectura son
+    absolutos: el tiempo de la lectura y de la escritura en NVS no se acumula como deriva. Si alguna vez se
+    pierde un instante no tiene sentido recuperarlo con lecturas seguidas, así que se salta. Su prioridad y
+    núcleo salen de la tabla de tareas.*/
+    struct task_plan_entry plan = task_plan_get(TASK_PLAN_SAMPLING);
+    if (periodic_task_create("Task show temperature", show_temp, NULL, period_ms, PERIODIC_TASK_SKIP,
+                             2048, plan.priority, plan.core) == NULL) {
+        ESP_LOGE(TAG, "Could not start the temperature sampling");
+    }
 }
\ No newline at end of file